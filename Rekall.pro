@@ -29,7 +29,7 @@ contains(QT_VERSION, "^4.*") {
 } else {
     message("Rekall For QT5 (very experimental)")
     DEFINES += QT5
-    QT      += widgets core gui opengl network script xml phonon webkit
+    QT      += widgets core gui opengl network script xml phonon webkit concurrent
 }
 
 TARGET    = Rekall
@@ -45,16 +45,16 @@ SOURCES  += tasks/taskslist.cpp tasks/feedlist.cpp tasks/taskprocess.cpp
 FORMS    += tasks/taskslist.ui  tasks/feedlist.ui \
     core/watchersnapshot.ui
 
-HEADERS  += core/watcherfeeling.h   core/watcher.h
-SOURCES  += core/watcherfeeling.cpp core/watcher.cpp
+HEADERS  += core/watcherfeeling.h   core/watcher.h   core/watcherinotify.h   core/watcherhasher.h
+SOURCES  += core/watcherfeeling.cpp core/watcher.cpp core/watcherinotify.cpp core/watcherhasher.cpp
 FORMS    += core/watcherfeeling.ui
 
 HEADERS  += rekall.h   gui/splash.h   misc/global.h   misc/options.h
 SOURCES  += rekall.cpp gui/splash.cpp misc/global.cpp misc/options.cpp
 FORMS    += rekall.ui  gui/splash.ui
 
-HEADERS  += core/sorting.h   core/phases.h   core/metadata.h   core/project.h   core/document.h   core/tag.h   core/cluster.h
-SOURCES  += core/sorting.cpp core/phases.cpp core/metadata.cpp core/project.cpp core/document.cpp core/tag.cpp core/cluster.cpp
+HEADERS  += core/sorting.h   core/phases.h   core/metadata.h   core/metadataindex.h   core/taglinker.h   core/tagsorter.h   core/crawler.h   core/projectsnapshot.h   core/project.h   core/document.h   core/tag.h   core/cluster.h
+SOURCES  += core/sorting.cpp core/phases.cpp core/metadata.cpp core/metadataindex.cpp core/taglinker.cpp core/tagsorter.cpp core/crawler.cpp core/projectsnapshot.cpp core/project.cpp core/document.cpp core/tag.cpp core/cluster.cpp
 FORMS    += core/sorting.ui  core/phases.ui
 
 HEADERS  += gui/timeline.h   gui/previewer.h   gui/playervideo.h   gui/timelinecontrol.h   gui/timelinegl.h   gui/previewerlabel.h
@@ -69,13 +69,13 @@ HEADERS  += items/uitreeview.h   items/uitreeviewwidget.h   items/uitreedelegate
 SOURCES  += items/uitreeview.cpp items/uitreeviewwidget.cpp items/uitreedelegate.cpp items/uifileitem.cpp
 FORMS    += items/uitreeview.ui
 
-HEADERS  += interfaces/udp.h   interfaces/fileuploadcontroller.h
-SOURCES  += interfaces/udp.cpp interfaces/fileuploadcontroller.cpp
+HEADERS  += interfaces/udp.h   interfaces/fileuploadcontroller.h   interfaces/projectapicontroller.h   interfaces/eventstreamcontroller.h   interfaces/requestmapper.h
+SOURCES  += interfaces/udp.cpp interfaces/fileuploadcontroller.cpp interfaces/projectapicontroller.cpp interfaces/eventstreamcontroller.cpp interfaces/requestmapper.cpp
 FORMS    += interfaces/udp.ui
-HEADERS  += interfaces/http/httplistener.h interfaces/http/httpconnectionhandler.h interfaces/http/httpconnectionhandlerpool.h interfaces/http/httprequest.h interfaces/http/httpresponse.h interfaces/http/httpcookie.h interfaces/http/httprequesthandler.h
+HEADERS  += interfaces/http/httplistener.h interfaces/http/httpconnectionhandler.h interfaces/http/httpconnectionhandlerpool.h interfaces/http/httpconnectionoutput.h interfaces/http/httprequest.h interfaces/http/httpresponse.h interfaces/http/httpcookie.h interfaces/http/httprequesthandler.h
 HEADERS  += interfaces/http/httpsession.h interfaces/http/httpsessionstore.h
 HEADERS  += interfaces/http/staticfilecontroller.h
-SOURCES  += interfaces/http/httplistener.cpp interfaces/http/httpconnectionhandler.cpp interfaces/http/httpconnectionhandlerpool.cpp interfaces/http/httprequest.cpp interfaces/http/httpresponse.cpp interfaces/http/httpcookie.cpp interfaces/http/httprequesthandler.cpp
+SOURCES  += interfaces/http/httplistener.cpp interfaces/http/httpconnectionhandler.cpp interfaces/http/httpconnectionhandlerpool.cpp interfaces/http/httpconnectionoutput.cpp interfaces/http/httprequest.cpp interfaces/http/httpresponse.cpp interfaces/http/httpcookie.cpp interfaces/http/httprequesthandler.cpp
 SOURCES  += interfaces/http/httpsession.cpp interfaces/http/httpsessionstore.cpp
 SOURCES  += interfaces/http/staticfilecontroller.cpp
 
@@ -0,0 +1,226 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "crawler.h"
+#include "items/uifileitem.h"
+#include <QtConcurrentRun>
+#ifndef Q_OS_WIN
+#include <sys/types.h>
+#include <dirent.h>
+#endif
+
+QHash<QString, CrawlerListing> Crawler::listings;
+QHash<QString, QDateTime> Crawler::listingsModified;
+quint32        Crawler::listingsGeneration = 0;
+QStringList    Crawler::queue;
+quint16        Crawler::queueBusy = 0;
+QMutex         Crawler::mutex;
+QWaitCondition Crawler::queueCondition;
+
+Crawler::Crawler(QObject *parent) :
+    QThread(parent) {
+}
+
+void Crawler::crawl(const QDir &dir) {
+    QTime timer;
+    timer.start();
+
+    mutex.lock();
+    queue.clear();
+    queue << path(dir);
+    queueBusy = 0;
+    quint32 directoriesBefore = listings.count();
+    mutex.unlock();
+
+    //Workers share the queue of directories to list
+    QList<Crawler*> workers;
+    for(quint16 i = 0 ; i < qMax(2, QThread::idealThreadCount()) ; i++) {
+        workers << new Crawler();
+        workers.last()->start();
+    }
+    foreach(Crawler *worker, workers)
+        worker->wait();
+    qDeleteAll(workers);
+
+    mutex.lock();
+    quint32 directories = listings.count() - directoriesBefore, entries = 0;
+    QHashIterator<QString, CrawlerListing> listingsIterator(listings);
+    while(listingsIterator.hasNext()) {
+        listingsIterator.next();
+        entries += listingsIterator.value().count();
+    }
+    mutex.unlock();
+    qDebug("[CRAWLER] %s : %d directories listed in %d ms with %d workers (%d entries cached)", qPrintable(path(dir)), directories, timer.elapsed(), workers.count(), entries);
+}
+
+void Crawler::run() {
+    forever {
+        mutex.lock();
+        while((queue.isEmpty()) && (queueBusy))
+            queueCondition.wait(&mutex);
+        if(queue.isEmpty()) {
+            mutex.unlock();
+            queueCondition.wakeAll();
+            return;
+        }
+        QString directory = queue.takeLast();
+        queueBusy++;
+        mutex.unlock();
+
+        QDateTime modified = modification(directory);
+        CrawlerListing directoryListing = read(directory);
+
+        mutex.lock();
+        store(directory, directoryListing, modified);
+        foreach(const CrawlerEntry &entry, directoryListing)
+            if((entry.isDir) && (!entry.isSymLink) && (UiFileItem::conformFile(entry.name, true)))
+                queue << directory + "/" + entry.name;
+        queueBusy--;
+        mutex.unlock();
+        queueCondition.wakeAll();
+    }
+}
+
+const CrawlerListing Crawler::listing(const QDir &dir) {
+    QString directory = path(dir);
+    QDateTime modified = modification(directory);
+
+    //Cached listings are only valid while the directory is not modified, unwatched folders are never invalidated
+    mutex.lock();
+    if((listings.contains(directory)) && (modified.isValid()) && (listingsModified.value(directory) == modified)) {
+        CrawlerListing directoryListing = listings.value(directory);
+        mutex.unlock();
+        return directoryListing;
+    }
+    mutex.unlock();
+
+    CrawlerListing directoryListing = read(directory);
+    QMutexLocker locker(&mutex);
+    store(directory, directoryListing, modified);
+    return directoryListing;
+}
+void Crawler::prefetch(const QStringList &directories) {
+    QStringList missing;
+    mutex.lock();
+    foreach(const QString &directory, directories)
+        if(!listings.contains(path(QDir(directory))))
+            missing << path(QDir(directory));
+    mutex.unlock();
+    if(missing.count())
+        QtConcurrent::run(&Crawler::prefetchListings, missing);
+}
+void Crawler::prefetchListings(const QStringList &directories) {
+    foreach(const QString &directory, directories) {
+        mutex.lock();
+        quint32 generation = listingsGeneration;
+        bool    listed     = listings.contains(directory);
+        mutex.unlock();
+        if(listed)
+            continue;
+
+        QDateTime modified = modification(directory);
+        CrawlerListing directoryListing = read(directory);
+
+        //Dropped if the directory changed meanwhile
+        QMutexLocker locker(&mutex);
+        if((generation == listingsGeneration) && (!listings.contains(directory)))
+            store(directory, directoryListing, modified);
+    }
+}
+void Crawler::invalidate(const QString &directory) {
+    QMutexLocker locker(&mutex);
+    listings.remove(path(QDir(directory)));
+    listingsModified.remove(path(QDir(directory)));
+    listingsGeneration++;
+}
+void Crawler::clear() {
+    QMutexLocker locker(&mutex);
+    listings.clear();
+    listingsModified.clear();
+    listingsGeneration++;
+}
+
+const QString Crawler::path(const QDir &dir) {
+    return QDir::cleanPath(dir.absolutePath());
+}
+const QDateTime Crawler::modification(const QString &directory) {
+    QDateTime modified = QFileInfo(directory).lastModified();
+    //Timestamps may only have a resolution of a second, a change in the same second as the listing would go unnoticed
+    if(modified.secsTo(QDateTime::currentDateTime()) < 2)
+        return QDateTime();
+    return modified;
+}
+void Crawler::store(const QString &directory, const CrawlerListing &directoryListing, const QDateTime &modified) {
+    //Called with the mutex locked, the modification date is taken before reading the directory
+    listings.insert(directory, directoryListing);
+    listingsModified.insert(directory, modified);
+}
+
+const CrawlerListing Crawler::read(const QString &directory) {
+    CrawlerListing directoryListing;
+#ifdef Q_OS_WIN
+    QFileInfoList files = QDir(directory).entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+    foreach(const QFileInfo &file, files) {
+        CrawlerEntry entry;
+        entry.name      = file.fileName();
+        entry.isDir     = file.isDir();
+        entry.isFile    = file.isFile();
+        entry.isSymLink = file.isSymLink();
+        directoryListing << entry;
+    }
+#else
+    //Type hints of readdir avoid a stat per entry
+    DIR *dir = opendir(QFile::encodeName(directory).constData());
+    if(dir) {
+        struct dirent *dirEntry;
+        while((dirEntry = readdir(dir)) != 0) {
+            if(dirEntry->d_name[0] == '.')
+                continue;
+            CrawlerEntry entry;
+            entry.name      = QFile::decodeName(dirEntry->d_name);
+            entry.isDir     = entry.isFile = entry.isSymLink = false;
+#ifdef DT_DIR
+            if(dirEntry->d_type == DT_DIR)          entry.isDir  = true;
+            else if(dirEntry->d_type == DT_REG)     entry.isFile = true;
+            else
+#endif
+            {
+                QFileInfo file(directory + "/" + entry.name);
+                entry.isDir     = file.isDir();
+                entry.isFile    = file.isFile();
+                entry.isSymLink = file.isSymLink();
+            }
+            if((entry.isDir) || (entry.isFile))
+                directoryListing << entry;
+        }
+        closedir(dir);
+    }
+#endif
+    qSort(directoryListing.begin(), directoryListing.end(), CrawlerEntry::sort);
+    return directoryListing;
+}
+
+
+bool CrawlerEntry::sort(const CrawlerEntry &first, const CrawlerEntry &second) {
+    return first.name.compare(second.name, Qt::CaseInsensitive) < 0;
+}
@@ -0,0 +1,76 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CRAWLER_H
+#define CRAWLER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+#include <QHash>
+#include <QDir>
+#include <QTime>
+#include <QDateTime>
+
+class CrawlerEntry {
+public:
+    QString name;
+    bool    isDir, isFile, isSymLink;
+public:
+    static bool sort(const CrawlerEntry &first, const CrawlerEntry &second);
+};
+typedef QList<CrawlerEntry> CrawlerListing;
+
+class Crawler : public QThread {
+    Q_OBJECT
+
+public:
+    explicit Crawler(QObject *parent = 0);
+
+protected:
+    void run();
+
+public:
+    static void crawl(const QDir &dir);
+    static const CrawlerListing listing(const QDir &dir);
+    static void prefetch(const QStringList &directories);
+    static void invalidate(const QString &path);
+    static void clear();
+private:
+    static const QString path(const QDir &dir);
+    static const CrawlerListing read(const QString &path);
+    static const QDateTime modification(const QString &path);
+    static void store(const QString &path, const CrawlerListing &directoryListing, const QDateTime &modified);
+    static void prefetchListings(const QStringList &directories);
+private:
+    static QHash<QString, CrawlerListing> listings;
+    static QHash<QString, QDateTime> listingsModified;
+    static quint32        listingsGeneration;
+    static QStringList    queue;
+    static quint16        queueBusy;
+    static QMutex         mutex;
+    static QWaitCondition queueCondition;
+};
+
+#endif // CRAWLER_H
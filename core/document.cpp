@@ -23,11 +23,16 @@
 
 #include "document.h"
 
+ObjectPool Document::pool(sizeof(Document), 128);
+
 Document::Document(ProjectBase *_project) :
     DocumentBase(_project) {
     project     = _project;
     project->addDocument(this);
 }
+Document::~Document() {
+    project->removeDocument(this);
+}
 
 Tag* Document::createTag(qint16 _versionSource, qint16 versionDest) {
     qint16 versionSource = getMetadataIndexVersion(_versionSource);
@@ -32,6 +32,10 @@ class Document : public DocumentBase {
 
 public:
     explicit Document(ProjectBase *_project);
+    ~Document();
+    static ObjectPool pool;
+    static void* operator new   (size_t size)                 { return pool.allocate(size); }
+    static void  operator delete(void *document, size_t size) { pool.release(document, size); }
 
 public:
     QList<Tag*> tags;
@@ -29,10 +29,15 @@ QStringList Metadata::suffixesTypeImage;
 QStringList Metadata::suffixesTypeAudio;
 QStringList Metadata::suffixesTypePatches;
 QStringList Metadata::suffixesTypePeople;
+QHash<QString, DocumentType> Metadata::suffixesTypes;
+MetadataIndex Metadata::index;
+QAtomicInt    Metadata::documentIdCounter;
+QSet<QString> Metadata::internedStrings;
 
 Metadata::Metadata(QObject *parent, bool createEmpty) :
     QObject(parent) {
     metadataMutex    = false;
+    documentId       = documentIdCounter.fetchAndAddRelaxed(1) + 1;   //Never reused, unlike the addresses of pooled documents
     chutierItem      = 0;
     tempStorage      = 0;
     status           = DocumentStatusReady;
@@ -49,11 +54,28 @@ Metadata::Metadata(QObject *parent, bool createEmpty) :
     if(!suffixesTypeVideo.count())
         suffixesTypeVideo << "3g2" << "3gp" << "4xm" << "a64" << "act" << "adf" << "adts" << "adx" << "aea" << "aiff" << "alaw" << "amr" << "anm" << "apc" << "ape" << "asf" << "asf_stream" << "ass" << "au" << "avi" << "avm2" << "avs" << "bethsoftvid" << "bfi" << "bin" << "bink" << "bit" << "bmv" << "c93" << "caf" << "cavsvideo" << "cdg" << "cdxl" << "crc" << "daud" << "dfa" << "dirac" << "dnxhd" << "dsicin" << "dts" << "dv" << "dvd" << "dxa" << "ea" << "ea_cdata" << "eac3" << "f32be" << "f32le" << "f4v" << "f64be" << "f64le" << "ffm" << "ffmetadata" << "film_cpk" << "filmstrip" << "flac" << "flic" << "flv" << "framecrc" << "framemd5" << "g722" << "g723_1" << "g729" << "gif" << "gsm" << "gxf" << "h261" << "h263" << "h264" << "hls" << "applehttp" << "ico" << "idcin" << "idf" << "iff" << "ilbc" << "image2" << "image2pipe" << "ingenient" << "ipmovie" << "ipod" << "ismv" << "iss" << "iv8" << "ivf" << "jacosub" << "jv" << "latm" << "lavfi" << "libmodplug" << "lmlm4" << "loas" << "lxf" << "m4v" << "matroska" << "matroska" << "webm" << "md5" << "mgsts" << "microdvd" << "mjpeg" << "mkvtimestamp_v2" << "mlp" << "mm" << "mmf" << "mov" << "mp4" << "3gp" << "mp2"<< "mp4" << "mpc" << "mpc8" << "mpg" << "mpeg" << "mpeg1video" << "mpeg2video" << "mpegts" << "mpegtsraw" << "mpegvideo" << "mpjpeg" << "msnwctcp" << "mtv" << "mulaw" << "mvi" << "mxf" << "mxf_d10" << "mxg" << "nc" << "nsv" << "null" << "nut" << "nuv" << "ogg" << "oma" << "paf" << "pmp" << "psp" << "psxstr" << "pva" << "qcp" << "r3d" << "rawvideo" << "rcv" << "realtext" << "rl2" << "rm" << "roq" << "rpl" << "rso" << "rtp" << "rtsp" << "s16be" << "s16le" << "s24be" << "s24le" << "s32be" << "s32le" << "s8" << "sami" << "sap" << "sbg" << "sdl" << "sdp" << "segment" << "shn" << "siff" << "smjpeg" << "smk" << "smoothstreaming" << "smush" << "sol" << "sox" << "spdif" << "srt" << "stream_segment" << "s" << "subviewer" << "svcd" << "swf" << "thp" << "tiertexseq" << "tmv" << "truehd" << "tta" << "tty" << "txd" << "u16be" << "u16le" << "u24be" << "u24le" << "u32be" << "u32le" << "u8" << "vc1" << "vc1test" << "vcd" << "vmd" << "vob" << "voc" << "vqf" << "w64" << "wav" << "wc3movie" << "webm" << "webvtt" << "wsaud" << "wsvqa" << "wtv" << "wv" << "xa" << "xbin" << "xmv" << "xwma" << "yop" << "yuv4mpegpipe";
 
+    //One lookup per file, lists are inserted from the lowest priority so that earlier lists win
+    if(suffixesTypes.isEmpty()) {
+        foreach(const QString &suffix, suffixesTypePeople)  suffixesTypes.insert(suffix, DocumentTypePeople);
+        foreach(const QString &suffix, suffixesTypeVideo)   suffixesTypes.insert(suffix, DocumentTypeVideo);
+        foreach(const QString &suffix, suffixesTypeImage)   suffixesTypes.insert(suffix, DocumentTypeImage);
+        foreach(const QString &suffix, suffixesTypeAudio)   suffixesTypes.insert(suffix, DocumentTypeAudio);
+        foreach(const QString &suffix, suffixesTypeDoc)     suffixesTypes.insert(suffix, DocumentTypeDoc);
+    }
+
     if(createEmpty)
         metadatas.append(QMetaDictionnay());
 }
 
 Metadata::~Metadata() {
+    index.remove(documentId);
+}
+
+UiFileItem* Metadata::getChutierItem() {
+    //Folders of the chutier are listed on expansion
+    if((!chutierItem) && (Global::chutier) && (file.isFile()))
+        chutierItem = UiFileItem::ensure(file, Global::chutier);
+    return chutierItem;
 }
 
 
@@ -101,12 +123,6 @@ bool Metadata::updateFile(const QFileInfo &_file, const QDir &dirBase, qint16 ve
     bool anEmptyMetaWasCreated = updateImport(file.baseName(), version);
     setType(DocumentTypeFile);
 
-    QFileInfoList filesContext = file.absoluteDir().entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot, QDir::Name | QDir::IgnoreCase);
-    QString fileContextVerbose = "";
-    foreach(const QFileInfo &fileContext, filesContext)
-        fileContextVerbose += ((fileContext.isDir())?("[DIR] "):("")) + fileContext.fileName() + ", ";
-    fileContextVerbose.chop(2);
-
     setMetadata("File",   "Basename",                file.baseName(), version);
     setMetadata("File",   "Owner",                   file.owner(),    version);
     setMetadata("File",   "File Creation Date/Time", file.created(),  version);
@@ -115,7 +131,6 @@ bool Metadata::updateFile(const QFileInfo &_file, const QDir &dirBase, qint16 ve
     else                        setMetadata("File", "File Modification Date/Time", file.lastModified(), version);
     setMetadata("Rekall", "Date/Time", getMetadata("File", "File Modification Date/Time", version), version);
     setMetadata("Rekall", "Extension",                   file.suffix().toUpper(), version);
-    //setMetadata("Rekall", "File context",                fileContextVerbose,      version);
 
     if(dirBase.exists()) {
         QDir dirBaseParent = dirBase;
@@ -125,12 +140,7 @@ bool Metadata::updateFile(const QFileInfo &_file, const QDir &dirBase, qint16 ve
 
 
     //Type
-    if(     suffixesTypeDoc   .contains(file.suffix().toLower()))   setType(DocumentTypeDoc,    version);
-    else if(suffixesTypeAudio .contains(file.suffix().toLower()))   setType(DocumentTypeAudio,  version);
-    else if(suffixesTypeImage .contains(file.suffix().toLower()))   setType(DocumentTypeImage,  version);
-    else if(suffixesTypeVideo .contains(file.suffix().toLower()))   setType(DocumentTypeVideo,  version);
-    else if(suffixesTypePeople.contains(file.suffix().toLower()))   setType(DocumentTypePeople, version);
-    else                                                            setType(DocumentTypeFile,   version);
+    setType(getTypeForSuffix(file.suffix()), version);
 
     QStringList documentKeywords;
     QStringList fileTags = QDir(Global::pathDocuments.absoluteFilePath() + "/").relativeFilePath(file.absoluteFilePath()).remove(file.suffix()).toLower().replace("-", " ").replace("_", " ").split("/", QString::SkipEmptyParts);
@@ -145,6 +155,8 @@ bool Metadata::updateFile(const QFileInfo &_file, const QDir &dirBase, qint16 ve
     }
     addKeyword(documentKeywords, version);
 
+    if(Global::currentProject)
+        Global::currentProject->indexDocument(this);
     if(anEmptyMetaWasCreated) {
         status = DocumentStatusWaiting;
         Global::taskList->addTask(this, TaskProcessTypeMetadata, version);
@@ -153,6 +165,35 @@ bool Metadata::updateFile(const QFileInfo &_file, const QDir &dirBase, qint16 ve
     return anEmptyMetaWasCreated;
 }
 
+void Metadata::benchmarkSuffixes() {
+    QStringList suffixes;
+    suffixes << suffixesTypeDoc << suffixesTypeAudio << suffixesTypeImage << suffixesTypeVideo << suffixesTypePeople << "xyz" << "md" << "JPG" << "MOV";
+    const quint32 lookups = 200000;
+    quint32 found = 0;
+    QTime timer;
+
+    //Previous classification, one list after the other
+    timer.start();
+    for(quint32 i = 0 ; i < lookups ; i++) {
+        QString suffix = suffixes.at(i % suffixes.count()).toLower();
+        if(     suffixesTypeDoc   .contains(suffix))   found++;
+        else if(suffixesTypeAudio .contains(suffix))   found++;
+        else if(suffixesTypeImage .contains(suffix))   found++;
+        else if(suffixesTypeVideo .contains(suffix))   found++;
+        else if(suffixesTypePeople.contains(suffix))   found++;
+    }
+    qint64 listsTime = timer.elapsed();
+
+    //Shared table
+    timer.start();
+    for(quint32 i = 0 ; i < lookups ; i++)
+        if(getTypeForSuffix(suffixes.at(i % suffixes.count())) != DocumentTypeFile)
+            found++;
+    qint64 tableTime = timer.elapsed();
+
+    qDebug("[SUFFIXES] %d lookups : %d ms with lists, %d ms with the table (%d suffixes, %d found)", lookups, (int)listsTime, (int)tableTime, suffixesTypes.count(), found);
+}
+
 bool Metadata::updateCard(const PersonCard &card, qint16 version) {
     bool anEmptyMetaWasCreated = updateImport(card.getFullname(), version);
     setType(DocumentTypePeople, version);
@@ -254,14 +295,28 @@ void Metadata::updateFeed() {
 
 
 const MetadataElement Metadata::getMetadata(const QString &key, qint16 version) const {
-    MetadataElement retour;
+    while(metadataMutex) {
+        qDebug("WAIT MUTEX");
+    }
 
+    if(metadatas.count())
+        return getMetadata(getMetadata(version), QString(), key);
+    return MetadataElement();
+}
+const MetadataElement Metadata::getMetadata(const QString &category, const QString &key, qint16 version) const {
     while(metadataMutex) {
         qDebug("WAIT MUTEX");
     }
 
-    if(metadatas.count()) {
-        QMapIterator<QString, QMetaMap> metaIterator(getMetadata(version));
+    if(metadatas.count())
+        return getMetadata(getMetadata(version), category, key);
+    return MetadataElement();
+}
+const MetadataElement Metadata::getMetadata(const QMetaDictionnay &metadata, const QString &category, const QString &key) {
+    //Also used on copies of the metadata by the snapshot worker
+    MetadataElement retour;
+    if(category.isEmpty()) {
+        QMapIterator<QString, QMetaMap> metaIterator(metadata);
         while(metaIterator.hasNext()) {
             metaIterator.next();
             if(metaIterator.value().contains(key)) {
@@ -270,34 +325,19 @@ const MetadataElement Metadata::getMetadata(const QString &key, qint16 version)
             }
         }
     }
-    return retour;
-}
-const MetadataElement Metadata::getMetadata(const QString &category, const QString &key, qint16 version) const {
-    if(category.isEmpty())
-        return getMetadata(key, version);
-    MetadataElement retour;
-
-    while(metadataMutex) {
-        qDebug("WAIT MUTEX");
-    }
-
-    if(metadatas.count()) {
-        if(key == "All") {
-            QString retourStr;
-            QMapIterator<QString, MetadataElement> metaIterator(getMetadata(version).value(category));
-            while(metaIterator.hasNext()) {
-                metaIterator.next();
-                if(!metaIterator.value().toString().isEmpty())
-                    retourStr += metaIterator.value().toString().trimmed().toLower() + ", ";
-            }
-            retourStr.chop(2);
-            retour = retourStr;
-        }
-        else {
-            if((getMetadata(version).contains(category)) && (getMetadata(version).value(category).contains(key)))
-                retour = getMetadata(version).value(category).value(key);
+    else if(key == "All") {
+        QString retourStr;
+        QMapIterator<QString, MetadataElement> metaIterator(metadata.value(category));
+        while(metaIterator.hasNext()) {
+            metaIterator.next();
+            if(!metaIterator.value().toString().isEmpty())
+                retourStr += metaIterator.value().toString().trimmed().toLower() + ", ";
         }
+        retourStr.chop(2);
+        retour = retourStr;
     }
+    else if((metadata.contains(category)) && (metadata.value(category).contains(key)))
+        retour = metadata.value(category).value(key);
     return retour;
 }
 
@@ -305,31 +345,26 @@ const MetadataElement Metadata::getMetadata(const QString &category, const QStri
 void Metadata::setMetadata(const QString &category, const QString &key, const QString &value, qint16 version) {
     if(key.toLower().contains("date"))
         setMetadata(category, key, QDateTime::fromString(value, "yyyy:MM:dd hh:mm:ss"), version);
-    else if(true) {
-        version = getMetadataIndexVersion(version);
-        metadataMutex = true;
-        metadatas[version][category][key] = value;
-        metadataMutex = false;
-        getCacheRefreshed(version);
-    }
+    else
+        setMetadataIndexed(category, key, MetadataElement(value), version);
 }
 void Metadata::setMetadata(const QString &category, const QString &key, const QDateTime &value, qint16 version) {
-    if(true) {
-        version = getMetadataIndexVersion(version);
-        metadataMutex = true;
-        metadatas[version][category][key] = value;
-        metadataMutex = false;
-        getCacheRefreshed(version);
-    }
+    setMetadataIndexed(category, key, MetadataElement(value), version);
 }
 void Metadata::setMetadata(const QString &category, const QString &key, const MetadataElement &value, qint16 version) {
-    if(true) {
-        version = getMetadataIndexVersion(version);
-        metadataMutex = true;
-        metadatas[version][category][key] = value;
-        metadataMutex = false;
-        getCacheRefreshed(version);
-    }
+    setMetadataIndexed(category, key, value, version);
+}
+void Metadata::setMetadataIndexed(const QString &category, const QString &key, const MetadataElement &value, qint16 version) {
+    version = getMetadataIndexVersion(version);
+    metadataMutex = true;
+    MetadataElement &element = metadatas[version][category][key];
+    QString oldValue = (element.isString())?(element.toString()):(QString());
+    element = value;
+    metadataMutex = false;
+    getCacheRefreshed(version);
+
+    //Dates are left to Sorting, their digits would only pollute the vocabulary
+    index.update(documentId, category, key, oldValue, (value.isString())?(value.toString()):(QString()));
 }
 void Metadata::setMetadata(const QString &category, const QString &key, qreal value, qint16 version) {
     setMetadata(category, key, QString::number(value), version);
@@ -567,7 +602,7 @@ void Metadata::deserializeMetadata(const QDomElement &xmlElement) {
             while(!metaNode.isNull()) {
                 QDomElement metaElement = metaNode.toElement();
                 if((!metaElement.isNull()) && (metaElement.nodeName() == "meta")) {
-                    setMetadata(metaElement.attribute("category"), metaElement.attribute("tagname"), metaElement.attribute("content"), metaElement.attribute("documentVersion", "-1").toInt());
+                    setMetadata(intern(metaElement.attribute("category")), intern(metaElement.attribute("tagname")), metaElement.attribute("content"), metaElement.attribute("documentVersion", "-1").toInt());
                 }
                 metaNode = metaNode.nextSibling();
             }
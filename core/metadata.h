@@ -25,7 +25,10 @@
 #define METADATA_H
 
 #include <QMutex>
+#include <QAtomicInt>
+#include <QSet>
 #include "items/uifileitem.h"
+#include "core/metadataindex.h"
 #include "misc/global.h"
 
 class MetadataWaveform : public QList< QPair<qreal,qreal> > {
@@ -161,7 +164,13 @@ public:
 protected:
     bool   metadataMutex;
     QImage photo;
+    quint32 documentId;
+    static QAtomicInt documentIdCounter;
+public:
+    inline quint32 getDocumentId() const { return documentId; }
 
+public:
+    UiFileItem* getChutierItem();
 public:
     bool updateFile(const QFileInfo &file, const QDir &dirBase = QDir(), qint16 version = -1, quint16 falseInfoForTest = 0);
     bool updateForCompatibility(qint16 version = -1);
@@ -186,12 +195,15 @@ public:
 public:
     const MetadataElement getMetadata(const QString &key, qint16 version = -1) const;
     const MetadataElement getMetadata(const QString &category,const QString &key, qint16 version = -1) const;
+    static const MetadataElement getMetadata(const QMetaDictionnay &metadata, const QString &category, const QString &key);
 public:
     void setMetadata(const QString &category, const QString &key, const QString &value, qint16 version);
     void setMetadata(const QString &category, const QString &key, const QDateTime &value, qint16 version);
     void setMetadata(const QString &category, const QString &key, const MetadataElement &value, qint16 version);
     void setMetadata(const QString &category, const QString &key, qreal value, qint16 version);
     void setMetadata(const QMetaDictionnay &metaDictionnay);
+private:
+    void setMetadataIndexed(const QString &category, const QString &key, const MetadataElement &value, qint16 version);
 
 public:
     inline const QString getName         (qint16 version = -1) const {  return metadatas.at(getMetadataIndexVersion(version)).getNameCache;          }
@@ -278,6 +290,18 @@ public:
 
 public:
     static QStringList suffixesTypeVideo, suffixesTypeDoc, suffixesTypeImage, suffixesTypeAudio, suffixesTypePatches, suffixesTypePeople;
+    static QHash<QString, DocumentType> suffixesTypes;
+    static inline DocumentType getTypeForSuffix(const QString &suffix) { return suffixesTypes.value(suffix.toLower(), DocumentTypeFile); }
+    static void benchmarkSuffixes();
+    static MetadataIndex index;
+    static QSet<QString> internedStrings;
+    static inline const QString intern(const QString &str) {
+        QSet<QString>::const_iterator internedString = internedStrings.constFind(str);
+        if(internedString != internedStrings.constEnd())
+            return *internedString;
+        internedStrings.insert(str);
+        return str;
+    }
 };
 
 #endif // METADATA_H
@@ -0,0 +1,234 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "metadataindex.h"
+
+MetadataIndex::MetadataIndex() {
+}
+
+
+void MetadataIndex::update(quint32 documentId, const QString &category, const QString &key, const QString &oldValue, const QString &newValue) {
+    if(oldValue == newValue)
+        return;
+
+    //Tokens are computed outside the lock, tasks feed the index from their threads
+    quint16 weight = getWeight(category, key);
+    QStringList oldTokens = tokenize(oldValue), newTokens = tokenize(newValue);
+    QMutexLocker locker(&mutex);
+    foreach(const QString &token, oldTokens)
+        remove(documentId, token, weight);
+    foreach(const QString &token, newTokens)
+        add(documentId, token, weight);
+}
+void MetadataIndex::remove(quint32 documentId) {
+    QMutexLocker locker(&mutex);
+    QHashIterator<QString, quint32> tokenIterator(documentTokens.value(documentId));
+    while(tokenIterator.hasNext()) {
+        tokenIterator.next();
+        QMap<QString, QHash<quint32, quint32> >::iterator posting = postings.find(tokenIterator.key());
+        if(posting != postings.end()) {
+            posting.value().remove(documentId);
+            if(posting.value().isEmpty())
+                postings.erase(posting);
+        }
+    }
+    documentTokens.remove(documentId);
+}
+void MetadataIndex::clear() {
+    QMutexLocker locker(&mutex);
+    postings.clear();
+    documentTokens.clear();
+}
+
+void MetadataIndex::add(quint32 documentId, const QString &token, quint32 weight) {
+    postings[token][documentId] += weight;
+    documentTokens[documentId][token] += weight;
+}
+void MetadataIndex::remove(quint32 documentId, const QString &token, quint32 weight) {
+    QMap<QString, QHash<quint32, quint32> >::iterator posting = postings.find(token);
+    if(posting == postings.end())
+        return;
+    QHash<quint32, quint32>::iterator postingDocument = posting.value().find(documentId);
+    if(postingDocument == posting.value().end())
+        return;
+    if(postingDocument.value() > weight)
+        postingDocument.value() -= weight;
+    else {
+        posting.value().erase(postingDocument);
+        if(posting.value().isEmpty())
+            postings.erase(posting);
+    }
+
+    QHash<quint32, QHash<QString, quint32> >::iterator document = documentTokens.find(documentId);
+    if(document == documentTokens.end())
+        return;
+    QHash<QString, quint32>::iterator documentToken = document.value().find(token);
+    if(documentToken == document.value().end())
+        return;
+    if(documentToken.value() > weight)
+        documentToken.value() -= weight;
+    else {
+        document.value().erase(documentToken);
+        if(document.value().isEmpty())
+            documentTokens.erase(document);
+    }
+}
+
+
+const QHash<quint32, quint32> MetadataIndex::query(const QString &query) const {
+    //Wildcard terms are kept as is, the others are split like indexed values
+    QStringList terms;
+    foreach(const QString &term, query.toLower().split(QRegExp("[\\s,;]+"), QString::SkipEmptyParts)) {
+        if(isWildcard(term))    terms << term;
+        else                    terms << tokenize(term);
+    }
+
+    QHash<quint32, quint32> retour;
+    if(terms.isEmpty())
+        return retour;
+
+    QMutexLocker locker(&mutex);
+    bool firstTerm = true;
+    foreach(const QString &term, terms) {
+        QHash<quint32, quint32> termResults = queryTerm(term);
+        if(firstTerm) {
+            retour = termResults;
+            firstTerm = false;
+        }
+        else {
+            QMutableHashIterator<quint32, quint32> resultIterator(retour);
+            while(resultIterator.hasNext()) {
+                resultIterator.next();
+                QHash<quint32, quint32>::const_iterator termResult = termResults.constFind(resultIterator.key());
+                if(termResult == termResults.constEnd())    resultIterator.remove();
+                else                                        resultIterator.setValue(resultIterator.value() + termResult.value());
+            }
+        }
+        if(retour.isEmpty())
+            break;
+    }
+    return retour;
+}
+const QHash<quint32, quint32> MetadataIndex::queryTerm(const QString &term) const {
+    QHash<quint32, quint32> retour;
+    foreach(const QString &token, matchingTokensUnlocked(term)) {
+        QMap<QString, QHash<quint32, quint32> >::const_iterator posting = postings.constFind(token);
+        if(posting != postings.constEnd()) {
+            QHashIterator<quint32, quint32> documentIterator(posting.value());
+            while(documentIterator.hasNext()) {
+                documentIterator.next();
+                retour[documentIterator.key()] += documentIterator.value();
+            }
+        }
+    }
+    return retour;
+}
+
+bool sortSearchResults(const QPair<quint32, quint32> &first, const QPair<quint32, quint32> &second) {
+    return first.first > second.first;
+}
+const QList<quint32> MetadataIndex::search(const QString &_query, quint16 limit) const {
+    QList< QPair<quint32, quint32> > results;
+    QHashIterator<quint32, quint32> resultIterator(query(_query));
+    while(resultIterator.hasNext()) {
+        resultIterator.next();
+        results << qMakePair(resultIterator.value(), resultIterator.key());
+    }
+    qStableSort(results.begin(), results.end(), sortSearchResults);
+
+    QList<quint32> retour;
+    for(quint16 i = 0 ; (i < results.count()) && ((limit == 0) || (i < limit)) ; i++)
+        retour << results.at(i).second;
+    return retour;
+}
+
+
+const QStringList MetadataIndex::matchingTokens(const QString &pattern) const {
+    QMutexLocker locker(&mutex);
+    return matchingTokensUnlocked(pattern.toLower());
+}
+const QStringList MetadataIndex::matchingTokensUnlocked(const QString &pattern) const {
+    QStringList retour;
+
+    //The literal head of the pattern narrows the scan on the sorted vocabulary
+    QString prefix = pattern.left(pattern.indexOf(QRegExp("[\\*\\?\\[]")));
+    if(prefix == pattern) {
+        if(postings.contains(pattern))
+            retour << pattern;
+        return retour;
+    }
+
+    bool prefixOnly = (pattern == prefix + "*");
+    QRegExp regexp(pattern, Qt::CaseInsensitive, QRegExp::Wildcard);
+    QMap<QString, QHash<quint32, quint32> >::const_iterator token = postings.lowerBound(prefix);
+    while((token != postings.constEnd()) && (token.key().startsWith(prefix))) {
+        if((prefixOnly) || (regexp.exactMatch(token.key())))
+            retour << token.key();
+        token++;
+    }
+    return retour;
+}
+
+
+void MetadataIndex::benchmark() const {
+    QStringList vocabulary;
+    quint32 documentCount = 0;
+    if(true) {
+        QMutexLocker locker(&mutex);
+        vocabulary    = postings.keys();
+        documentCount = documentTokens.count();
+    }
+    if(vocabulary.isEmpty())
+        return;
+
+    //Random exact, prefix, wildcard and multi-terms queries picked in the indexed vocabulary
+    QStringList queries;
+    for(quint16 i = 0 ; i < 100 ; i++) {
+        const QString &token  = vocabulary.at(qrand() % vocabulary.count());
+        const QString &token2 = vocabulary.at(qrand() % vocabulary.count());
+        queries << token << token.left(2) + "*" << "*" + token.mid(1, 2) + "*" << token + " " + token2.left(1) + "*";
+    }
+
+    quint32 resultCount = 0;
+    QTime timer;
+    timer.start();
+    foreach(const QString &query, queries)
+        resultCount += search(query).count();
+    qDebug("[INDEX] %d documents, %d tokens : %d queries in %d ms (%d results)", documentCount, vocabulary.count(), queries.count(), timer.elapsed(), resultCount);
+}
+
+
+const QStringList MetadataIndex::tokenize(const QString &value) {
+    QStringList retour;
+    foreach(const QString &token, value.toLower().split(QRegExp("[\\W_]+"), QString::SkipEmptyParts))
+        if(token.length() > 1)
+            retour << token;
+    return retour;
+}
+quint16 MetadataIndex::getWeight(const QString &category, const QString &key) {
+    //Names and user-written documentId rank above file and exif fields
+    if(category != "Rekall")                                                                        return 1;
+    else if(key == "Name")                                                                          return 8;
+    else if((key == "Keywords") || (key == "Author") || (key == "Comments") || (key == "Group"))    return 4;
+    else                                                                                            return 2;
+}
@@ -0,0 +1,73 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef METADATAINDEX_H
+#define METADATAINDEX_H
+
+#include <QMap>
+#include <QHash>
+#include <QMutex>
+#include <QRegExp>
+#include <QTime>
+#include <QStringList>
+
+//Full-text index of the documentId of the documents. Its only consumer is the document search of
+//the API (/api/documents?text=): the matches of Sorting test substrings of a single criteria,
+//which tokens cannot answer, and the chutier has no search field.
+//Documents are keyed by their id, addresses of deleted documents are reused by the pool.
+class MetadataIndex {
+public:
+    explicit MetadataIndex();
+
+private:
+    mutable QMutex mutex;
+    QMap<QString, QHash<quint32, quint32> >  postings;
+    QHash<quint32, QHash<QString, quint32> > documentTokens;
+private:
+    void add   (quint32 documentId, const QString &token, quint32 weight);
+    void remove(quint32 documentId, const QString &token, quint32 weight);
+    const QHash<quint32, quint32> queryTerm(const QString &term) const;
+    const QStringList matchingTokensUnlocked(const QString &pattern) const;
+
+public:
+    void update(quint32 documentId, const QString &category, const QString &key, const QString &oldValue, const QString &newValue);
+    void remove(quint32 documentId);
+    void clear();
+
+public:
+    const QHash<quint32, quint32> query(const QString &query) const;
+    const QList<quint32> search(const QString &query, quint16 limit = 0) const;
+    const QStringList matchingTokens(const QString &pattern) const;
+    inline quint32 getTokenCount()    const { QMutexLocker locker(&mutex); return postings.count();       }
+    inline quint32 getDocumentCount() const { QMutexLocker locker(&mutex); return documentTokens.count(); }
+
+public:
+    void benchmark() const;
+
+public:
+    static const QStringList tokenize(const QString &value);
+    static quint16 getWeight(const QString &category, const QString &key);
+    static inline bool isWildcard(const QString &term) { return (term.contains("*")) || (term.contains("?")) || (term.contains("[")); }
+};
+
+#endif // METADATAINDEX_H
@@ -22,12 +22,28 @@
 */
 
 #include "project.h"
+#include "interfaces/eventstreamcontroller.h"
 
 Project::Project(QWidget *parent) :
     ProjectBase(parent) {
     categoryColorOpacity = categoryColorOpacityDest = 0;
     textureStrips.setTexture(":/textures/res_texture_strips.png");
     timelineFilesMenu = new QMenu(Global::mainWindow);
+    tagLinker = new TagLinker(this);
+    tagSorter = new TagSorter(this);
+    snapshotDirty = false;
+}
+Project::~Project() {
+    //Documents unregister from their project when deleted, they must go before QObject deletes them as children
+    tagLinker->cancel();
+    tagSorter->cancel();
+    ProjectSnapshot::clear();
+    QList<Document*> documentsToDelete = documents;
+    documents.clear();
+    documentsByPath.clear();
+    documentsByHash.clear();
+    documentsIndexKeys.clear();
+    qDeleteAll(documentsToDelete);
 }
 
 bool Project::open(const QFileInfoList &files, UiTreeView *view) {
@@ -52,6 +68,7 @@ bool Project::open(const QFileInfoList &files, UiTreeView *view) {
                         QFileInfo documentFile = QFileInfo(file.dir().absolutePath() + "/" + document->getMetadata("Rekall", "Folder", -1).toString() + document->getMetadata("File", "File Name", -1).toString());
                         if((documentFile.isFile()) && (documentFile.exists()))
                             document->file = documentFile;
+                        indexDocument(document);
                     }
                     documentNode = documentNode.nextSibling();
                 }
@@ -80,35 +97,33 @@ bool Project::open(const QFileInfoList &files, UiTreeView *view) {
         QDir dir(file.absoluteFilePath());
         if(file.isFile())
             dir.cdUp();
+        Crawler::crawl(dir);
         UiFileItem::syncWith(QFileInfoList() << dir.absolutePath(), view->getTree());
         open(dir, dir);
     }
 
     foreach(Person *person, persons)
         person->updateGUI();
+    qDebug("%s", qPrintable(Document::pool.report("Document")));
+    qDebug("%s", qPrintable(Tag::pool.report("Tag")));
+    qDebug("[POOL] Metadata : %d interned category and key names", Metadata::internedStrings.count());
 
     Global::timelineSortChanged = Global::viewerSortChanged = Global::eventsSortChanged = true;
     //Global::groupes->needCalulation = true;
     return retour;
 }
 void Project::open(const QDir &dir, const QDir &dirBase) {
-    QFileInfoList files = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot, QDir::Name | QDir::IgnoreCase);
-    foreach(const QFileInfo &file, files) {
-        if((file.isFile()) && (UiFileItem::conformFile(file))) {
-            Document *document = 0;
-            bool documentExisted = false;
-            foreach(Document *searchDocument, documents) {
-                if(searchDocument->file == file) {
-                    documentExisted = true;
-                    document = searchDocument;
-                    break;
-                }
-            }
+    QString dirPath = QDir::cleanPath(dir.absolutePath()) + "/";
+    foreach(const CrawlerEntry &entry, Crawler::listing(dir)) {
+        QFileInfo file(dirPath + entry.name);
+        if((entry.isFile) && (UiFileItem::conformFile(entry.name, false))) {
+            Document *document = getDocument(file.absoluteFilePath());
+            bool documentExisted = (document != 0);
             if(document == 0)
                 document = new Document(this);
 
             document->chutierItem = UiFileItem::find(file, Global::chutier);
-            if(file.absoluteFilePath().contains("Test.txt"))
+            if((document->chutierItem) && (file.absoluteFilePath().contains("Test.txt")))
                 document->chutierItem->setData(1, Qt::EditRole, true);
 
             if(documentExisted) {
@@ -138,7 +153,7 @@ void Project::open(const QDir &dir, const QDir &dirBase) {
                 }
             }
         }
-        else if((file.isDir()) && (UiFileItem::conformFile(file)))
+        else if((entry.isDir) && (UiFileItem::conformFile(entry.name, true)))
             open(QDir(file.absoluteFilePath() + "/"), dirBase);
     }
 
@@ -175,7 +190,15 @@ void Project::save() {
     xmlFile.close();
 }
 void Project::close() {
+    tagLinker->cancel();
+    tagSorter->cancel();
+    Crawler::clear();
+    ProjectSnapshot::clear();
+    snapshotDirty = false;
     timelineSortTags.clear();
+    timelineSortCategories.clear();
+    timelineSortPhases.clear();
+    guiCategories.clear();
     viewerTags.clear();
     eventsTags.clear();
     timelineClusters.clear();
@@ -183,7 +206,21 @@ void Project::close() {
     Global::selectedTags.clear();
     Global::selectedTagsInAction.clear();
     Global::selectedTagHover = Global::timeMarkerAdded = 0;
+    Global::renders.clear();
+
+    //Documents own their tags, all slots go back to the pools and their blocks are freed at once
+    QList<Document*> documentsToDelete = documents;
     documents.clear();
+    documentsByPath.clear();
+    documentsByHash.clear();
+    documentsIndexKeys.clear();
+    qDeleteAll(documentsToDelete);
+    Metadata::index.clear();
+    Metadata::internedStrings.clear();
+    qDebug("%s", qPrintable(Document::pool.report("Document")));
+    qDebug("%s", qPrintable(Tag::pool.report("Tag")));
+    Document::pool.trim();
+    Tag::pool.trim();
     Global::mainWindow->displayMetadataAndSelect();
     Global::timelineSortChanged = Global::viewerSortChanged = Global::eventsSortChanged = true;
     //Global::groupes->needCalulation = true;
@@ -191,11 +228,39 @@ void Project::close() {
 
 
 
-Document* Project::getDocument(const QString &name) const {
-    foreach(Document *document, documents)
-        if(document->file.absoluteFilePath() == name)
-            return document;
-    return 0;
+void Project::indexDocument(void *_document) {
+    Document *document = (Document*)_document;
+    QHash<Document*, QPair<QString, QString> >::iterator indexKeys = documentsIndexKeys.find(document);
+    if(indexKeys == documentsIndexKeys.end())
+        return;
+
+    QString path = (document->file.filePath().isEmpty())?(QString()):(document->file.absoluteFilePath());
+    QString hash = document->getMetadata("File", "Hash").toString();
+    if((indexKeys.value().first == path) && (indexKeys.value().second == hash))
+        return;
+
+    //Rename or new content : old keys are dropped before the new ones are added
+    if((!indexKeys.value().first.isEmpty()) && (documentsByPath.value(indexKeys.value().first) == document))
+        documentsByPath.remove(indexKeys.value().first);
+    if(!indexKeys.value().second.isEmpty())
+        documentsByHash.remove(indexKeys.value().second, document);
+    if((!path.isEmpty()) && (!documentsByPath.contains(path)))
+        documentsByPath.insert(path, document);
+    if(!hash.isEmpty())
+        documentsByHash.insert(hash, document);
+    indexKeys.value() = qMakePair(path, hash);
+}
+void Project::removeDocument(void *_document) {
+    Document *document = (Document*)_document;
+    QHash<Document*, QPair<QString, QString> >::iterator indexKeys = documentsIndexKeys.find(document);
+    if(indexKeys == documentsIndexKeys.end())
+        return;
+    if((!indexKeys.value().first.isEmpty()) && (documentsByPath.value(indexKeys.value().first) == document))
+        documentsByPath.remove(indexKeys.value().first);
+    if(!indexKeys.value().second.isEmpty())
+        documentsByHash.remove(indexKeys.value().second, document);
+    documentsIndexKeys.erase(indexKeys);
+    documents.removeOne(document);
 }
 
 
@@ -277,14 +342,13 @@ void Project::fireEvents() {
             }
 
 
-        //Events
-        eventsTags.clear();
+        //Events, sorted in background
+        QList<Tag*> eventsTagsToSort;
         foreach(Document *document, documents)
             foreach(Tag *tag, document->tags)
                 if(tag->isAcceptableWithSortFilters(true))
-                    eventsTags.append(tag);
-        //Sorting events
-        qSort(eventsTags.begin(), eventsTags.end(), Tag::sortEvents);
+                    eventsTagsToSort.append(tag);
+        tagSorter->sortEvents(eventsTagsToSort);
 
         //Groupes
         Global::groupes->addCheckStart();
@@ -326,6 +390,7 @@ void Project::fireEvents() {
     if(Global::metaChanged) {
         emit(displayMetadata());
         Global::metaChanged = false;
+        snapshotDirty = true;
     }
 
     //Opacity
@@ -347,11 +412,13 @@ void Project::fireEvents() {
     }
 
     //Fire events
+    tagSorter->publishEvents(eventsTags);
     bool annotationChanged = false;
     foreach(Tag *tag, eventsTags)
         annotationChanged |= tag->fireEvents();
     if(!annotationChanged)
         Global::mainWindow->changeAnnotation(0);
+    EventStreamController::publishPlayhead(Global::time, Global::timerPlay);
 
     //Progress = viewer reorder
     Global::viewerSortChanged = Global::timerPlay;
@@ -361,10 +428,14 @@ const QRectF Project::paintTimeline(bool before) {
     QRectF retour;
 
     if(before) {
+        //Links and order computed in background
+        tagLinker->publish();
+        tagSorter->publishTimeline(timelineSortTags, timelineSortCategories, timelineSortPhases);
+
         //Gather info about tags and classify them
         if(Global::timelineSortChanged) {
-            //Clear
-            timelineSortTags.clear();
+            //Clear, previous order stays displayed until the new one is sorted
+            QVector<TimelineSortEntry> timelineSortTagsToSort;
             QMap<QString, QMap<QString, Cluster*> > clustersToLink;
             QMapIterator<QPair<QString, QString>, Cluster*> timelineClustersIterator(timelineClusters);
             while(timelineClustersIterator.hasNext()) {
@@ -385,20 +456,9 @@ const QRectF Project::paintTimeline(bool before) {
 
             //Browse documents
             Global::tagSortCriteria->addCheckStart();
-            quint16 nbDuplicates = 0, nbHistories = 0;
             foreach(Document *document, documents) {
-                QList<Tag*> documentHistoryTags;
-
-                //Add tags to list + create history links
+                //Add tags to list
                 foreach(Tag *tag, document->tags) {
-                    //Add to linked tags container for this document
-                    if(document->getMetadataCount() > 1)
-                        documentHistoryTags.append(tag);
-
-                    //Resets histry
-                    tag->historyTags.clear();
-                    tag->hashTags.clear();
-
                     //Add to timeline if displayable
                     if(tag->isAcceptableWithSortFilters(false)) {
                         QString sorting = Tag::getCriteriaSort(tag).toLower();
@@ -414,64 +474,20 @@ const QRectF Project::paintTimeline(bool before) {
                                 timelineClusters[key]->add(tag);
                                 clustersToLink[cluster][sorting] = timelineClusters.value(key);
                             }
-                            timelineSortTags[phase][sorting][cluster].append(tag);
+                            TimelineSortEntry entry;
+                            entry.phase   = phase;
+                            entry.sorting = sorting;
+                            entry.cluster = cluster;
+                            entry.color   = Tag::getCriteriaColor(tag);
+                            entry.name    = document->getName(tag->getDocumentVersion());
+                            entry.version = tag->getDocumentVersion();
+                            entry.tag     = tag;
+                            timelineSortTagsToSort.append(entry);
                         }
                         if(tag->getDocument()->getFunction() != DocumentFunctionRender)
                             Global::tagSortCriteria->addCheck(sorting, Tag::getCriteriaSortFormated(tag), "");
                     }
                 }
-
-                //More histories with hash detection
-                QList<Tag*> hashTags;
-                QString documentHash = document->getMetadata("File", "Hash").toString();
-                if(!documentHash.isEmpty()) {
-                    foreach(Document *documentHashSearch, documents) {
-                        if((document != documentHashSearch) && (documentHash == documentHashSearch->getMetadata("File", "Hash").toString())) {
-                            nbDuplicates++;
-                            foreach(Tag *tagHashToAdd, documentHashSearch->tags) {
-                                bool okAddTag = true;
-                                foreach(Tag *tag, document->tags)
-                                    if(tagHashToAdd->hashTags.contains(tag)) {
-                                        okAddTag = false;
-                                        break;
-                                    }
-                                if(okAddTag)
-                                    hashTags.append(tagHashToAdd);
-                            }
-                        }
-                    }
-                }
-
-                //History tags
-                if(documentHistoryTags.count()) {
-                    nbHistories++;
-                    if(Global::showHistory) {
-                        if(Global::tagSortCriteria->isDate()) {
-                            //Sort by version number
-                            QList<Tag*> historyTagsVersionBefore;
-                            for(quint16 version = 0 ; version < document->getMetadataCount() ; version++) {
-                                QList<Tag*> historyTagsVersionNow;
-                                foreach(Tag* tag, documentHistoryTags) {
-                                    if(tag->getDocumentVersion() == version) {
-                                        tag->historyTags = historyTagsVersionBefore;
-                                        historyTagsVersionNow.append(tag);
-                                    }
-                                }
-                                historyTagsVersionBefore = historyTagsVersionNow;
-                            }
-                        }
-                        else {
-                            //Add history tags to last version tag
-                            foreach(Tag* tag, documentHistoryTags)
-                                if(Tag::isTagLastVersion(tag))
-                                    tag->historyTags = documentHistoryTags;
-                        }
-                    }
-                }
-                //Add hash tags
-                if(Global::timelineGL->showHashedTagsDest)
-                    foreach(Tag* tag, document->tags)
-                        tag->hashTags.append(hashTags);
             }
             Global::tagSortCriteria->addCheckEnd();
 
@@ -488,27 +504,22 @@ const QRectF Project::paintTimeline(bool before) {
                 }
             }
 
-            //Quantity per categories
-            QMapIterator<QString, QMap<QString, QMap<QString, QList<Tag*> > > > categoriesInPhasesIterator(timelineSortTags);
-            while(categoriesInPhasesIterator.hasNext()) {
-                categoriesInPhasesIterator.next();
-                QMapIterator<QString, QMap<QString, QList<Tag*> > > clustersInCategoriesIterator(categoriesInPhasesIterator.value());
-                while(clustersInCategoriesIterator.hasNext()) {
-                    clustersInCategoriesIterator.next();
-                    QMapIterator<QString, QList<Tag*> > tagsInClusterIterator(clustersInCategoriesIterator.value());
-                    while(tagsInClusterIterator.hasNext()) {
-                        tagsInClusterIterator.next();
-                        qSort(timelineSortTags[categoriesInPhasesIterator.key()][clustersInCategoriesIterator.key()][tagsInClusterIterator.key()].begin(), timelineSortTags[categoriesInPhasesIterator.key()][clustersInCategoriesIterator.key()][tagsInClusterIterator.key()].end(), Tag::sortColor);
-                    }
-                }
-            }
+            //Single sort on precomputed keys, published on a next frame
+            tagSorter->sortTimeline(timelineSortTagsToSort);
 
-            //Update timeline
-            Global::timeline->setDuplicates(nbDuplicates/2);
-            Global::timeline->setHistories(nbHistories);
+            //History and duplicate links, published on a next frame
+            tagLinker->compute(documents);
 
             //Unlock
             Global::timelineSortChanged = false;
+            snapshotDirty = true;
+        }
+
+        //Snapshot for the HTTP queries, at most once per second
+        if((snapshotDirty) && ((snapshotTimer.isNull()) || (snapshotTimer.elapsed() > 1000))) {
+            ProjectSnapshot::publish(documents);
+            snapshotDirty = false;
+            snapshotTimer.start();
         }
 
 
@@ -524,22 +535,20 @@ const QRectF Project::paintTimeline(bool before) {
         quint16 categoryIndex = 0;
         QPointF tagSortPosOffset = QPointF(0, Global::timelineTagVSpacingSeparator), categoryStart = QPointF(0, 0), phaseStart = QPointF(0, 0);
         guiCategories.clear();
-        QMapIterator<QString, QMap<QString, QMap<QString, QList<Tag*> > > > categoriesInPhasesIterator(timelineSortTags);
-        while(categoriesInPhasesIterator.hasNext()) {
-            categoriesInPhasesIterator.next();
+        for(quint32 phaseRangeIndex = 0 ; phaseRangeIndex < (quint32)timelineSortPhases.count() ; phaseRangeIndex++) {
+            const TimelineSortRange &phaseRange = timelineSortPhases.at(phaseRangeIndex);
 
-            QString phase        = categoriesInPhasesIterator.key();
+            QString phase        = phaseRange.phase;
             //QString phaseVerbose = Global::groupes->getVerbosePhaseFor(phase);
             if(debug)
-                qDebug("\t > [Phase] |%s| (nb = %d)", qPrintable(phase), categoriesInPhasesIterator.value().count());
+                qDebug("\t > [Phase] |%s| (nb = %d)", qPrintable(phase), phaseRange.end - phaseRange.start);
 
-            QMapIterator<QString, QMap<QString, QList<Tag*> > > clustersInCategoriesIterator(categoriesInPhasesIterator.value());
-            while(clustersInCategoriesIterator.hasNext()) {
-                clustersInCategoriesIterator.next();
+            for(quint32 categoryRangeIndex = phaseRange.start ; categoryRangeIndex < phaseRange.end ; categoryRangeIndex++) {
+                const TimelineSortRange &categoryRange = timelineSortCategories.at(categoryRangeIndex);
 
                 bool categoryIsRender = false;
 
-                QString sorting = clustersInCategoriesIterator.key();
+                QString sorting = categoryRange.sorting;
                 if(debug)
                     qDebug("\t\t > [Sorting] |%s|", qPrintable(sorting));
 
@@ -553,73 +562,66 @@ const QRectF Project::paintTimeline(bool before) {
                 bool tagCategoryIsSelected = false;
 
                 //Draw tags of this categetory
-                QMapIterator<QString, QList<Tag*> > tagsInClusterIterator2(clustersInCategoriesIterator.value());
-                while(tagsInClusterIterator2.hasNext()) {
-                    tagsInClusterIterator2.next();
-
-                    QString cluster = tagsInClusterIterator2.key();
-                    if(debug)
-                        qDebug("\t\t\t > [Cluster] |%s| (%d)", qPrintable(cluster), tagsInClusterIterator2.value().count());
-
-                    foreach(Tag *tag, tagsInClusterIterator2.value()) {
-                        QRectF tagRect = tag->getTimelineBoundingRect().translated(tagSortPosOffset);
-                        QPointF tagPosOffset;
-
-                        //Category in selection
-                        tagCategoryIsSelected |= (Global::selectedTags.contains(tag) == true);
-                        tagCategoryIsSelected |= (Global::selectedTagsInAction.contains(tag) == true);
-                        tagCategoryIsSelected |= (tag == Global::selectedTagHover);
-
-                        //Get info about category and analysis
-                        if(tagCategory.isEmpty()) {
-                            tagCategory = " " + Tag::getCriteriaSortFormated(tag).trimmed().toUpper();
-                            if(clustersInCategoriesIterator.hasNext()) {
-                                clustersInCategoriesIterator.next();
-                                if(clustersInCategoriesIterator.value().count())
-                                    if(clustersInCategoriesIterator.value().value(clustersInCategoriesIterator.value().keys().first()).count())
-                                        if(clustersInCategoriesIterator.value().value(clustersInCategoriesIterator.value().keys().first()).first()->getDocument()->getFunction() == DocumentFunctionRender)
-                                            nextCategoryIsRender = true;
-                                clustersInCategoriesIterator.previous();
-                            }
-                            categoryIsRender = (tag->getDocument()->getFunction() == DocumentFunctionRender);
-                        }
+                QString cluster;
+                for(quint32 index = categoryRange.start ; index < categoryRange.end ; index++) {
+                    Tag *tag = timelineSortTags.at(index).tag;
+                    if((debug) && ((index == categoryRange.start) || (cluster != timelineSortTags.at(index).cluster))) {
+                        cluster = timelineSortTags.at(index).cluster;
+                        qDebug("\t\t\t > [Cluster] |%s|", qPrintable(cluster));
+                    }
 
-                        //Drawing
-                        bool tagZoneIntersection = false;
-                        while(!tagZoneIntersection) {
-                            tagZoneIntersection = true;
-                            foreach(const QRectF &zone, zones) {
-                                if(tagRect.intersects(zone))
-                                    tagZoneIntersection = false;
-                            }
-                            if(!tagZoneIntersection) {
-                                qreal maxWidth = Global::timelineGlobalDocsWidth - 2*Global::timelineTagHeight;
-                                if(!Global::tagHorizontalCriteria->isTimeline())
-                                    maxWidth = 5 * Global::timeUnit - 3 * Global::timelineTagHeight;
-
-                                if(((tag->getType() == TagTypeGlobal) && (Global::tagHorizontalCriteria->isTimeline())) || (!Global::tagHorizontalCriteria->isTimeline())) {
-                                    if(tagPosOffset.x() < maxWidth) {
-                                        tagPosOffset +=   QPointF(Global::timelineTagHeight, 0);
-                                        tagRect.translate(QPointF(Global::timelineTagHeight, 0));
-                                    }
-                                    else {
-                                        tagPosOffset +=   QPointF(-tagPosOffset.x(), Global::timelineTagHeight + Global::timelineTagVSpacing);
-                                        tagRect.translate(QPointF(-tagRect.width(),  Global::timelineTagHeight + Global::timelineTagVSpacing));
-                                    }
+                    QRectF tagRect = tag->getTimelineBoundingRect().translated(tagSortPosOffset);
+                    QPointF tagPosOffset;
+
+                    //Category in selection
+                    tagCategoryIsSelected |= (Global::selectedTags.contains(tag) == true);
+                    tagCategoryIsSelected |= (Global::selectedTagsInAction.contains(tag) == true);
+                    tagCategoryIsSelected |= (tag == Global::selectedTagHover);
+
+                    //Get info about category and analysis
+                    if(tagCategory.isEmpty()) {
+                        tagCategory = " " + Tag::getCriteriaSortFormated(tag).trimmed().toUpper();
+                        if((categoryRangeIndex+1) < phaseRange.end)
+                            if(timelineSortTags.at(timelineSortCategories.at(categoryRangeIndex+1).start).tag->getDocument()->getFunction() == DocumentFunctionRender)
+                                nextCategoryIsRender = true;
+                        categoryIsRender = (tag->getDocument()->getFunction() == DocumentFunctionRender);
+                    }
+
+                    //Drawing
+                    bool tagZoneIntersection = false;
+                    while(!tagZoneIntersection) {
+                        tagZoneIntersection = true;
+                        foreach(const QRectF &zone, zones) {
+                            if(tagRect.intersects(zone))
+                                tagZoneIntersection = false;
+                        }
+                        if(!tagZoneIntersection) {
+                            qreal maxWidth = Global::timelineGlobalDocsWidth - 2*Global::timelineTagHeight;
+                            if(!Global::tagHorizontalCriteria->isTimeline())
+                                maxWidth = 5 * Global::timeUnit - 3 * Global::timelineTagHeight;
+
+                            if(((tag->getType() == TagTypeGlobal) && (Global::tagHorizontalCriteria->isTimeline())) || (!Global::tagHorizontalCriteria->isTimeline())) {
+                                if(tagPosOffset.x() < maxWidth) {
+                                    tagPosOffset +=   QPointF(Global::timelineTagHeight, 0);
+                                    tagRect.translate(QPointF(Global::timelineTagHeight, 0));
                                 }
                                 else {
-                                    tagPosOffset +=   QPointF(0, Global::timelineTagHeight + Global::timelineTagVSpacing);
-                                    tagRect.translate(QPointF(0, Global::timelineTagHeight + Global::timelineTagVSpacing));
+                                    tagPosOffset +=   QPointF(-tagPosOffset.x(), Global::timelineTagHeight + Global::timelineTagVSpacing);
+                                    tagRect.translate(QPointF(-tagRect.width(),  Global::timelineTagHeight + Global::timelineTagVSpacing));
                                 }
                             }
-                            else
-                                tag->setTimelinePos(tagPosOffset + tagSortPosOffset + QPointF(Global::timelineHeaderSize.width() + Global::timelineGlobalDocsWidth, 0));
+                            else {
+                                tagPosOffset +=   QPointF(0, Global::timelineTagHeight + Global::timelineTagVSpacing);
+                                tagRect.translate(QPointF(0, Global::timelineTagHeight + Global::timelineTagVSpacing));
+                            }
                         }
-                        //Drawing
-                        retour = retour.united(tag->paintTimeline(before));
-                        zones.append(tagRect);
-                        yCategoryMax = qMax(yCategoryMax, tagRect.bottom());
+                        else
+                            tag->setTimelinePos(tagPosOffset + tagSortPosOffset + QPointF(Global::timelineHeaderSize.width() + Global::timelineGlobalDocsWidth, 0));
                     }
+                    //Drawing
+                    retour = retour.united(tag->paintTimeline(before));
+                    zones.append(tagRect);
+                    yCategoryMax = qMax(yCategoryMax, tagRect.bottom());
                 }
 
                 //Extract category name and rect, store it for caching
@@ -664,13 +666,13 @@ const QRectF Project::paintTimeline(bool before) {
                     }
                     glScissor(Global::timelineHeaderSize.width(), 0, Global::timelineGL->width() - Global::timelineHeaderSize.width(), Global::timelineGL->height() - Global::timelineHeaderSize.height());
                 }
-                guiCategories.append(qMakePair(tagCategoryRect.translated(QPointF(0, Global::timelineHeaderSize.height())), qMakePair(phase, sorting)));
+                guiCategories.append(qMakePair(tagCategoryRect.translated(QPointF(0, Global::timelineHeaderSize.height())), categoryRangeIndex));
 
                 //Super separator si big change of category
                 qreal vSpacing = Global::timelineTagVSpacingSeparator+1;
                 if(((categoryIsRender) && (!nextCategoryIsRender)) || ((!categoryIsRender) && (nextCategoryIsRender)))
                     vSpacing = Global::timelineTagVSpacingSeparator+1;
-                if((!clustersInCategoriesIterator.hasNext()) && (categoriesInPhasesIterator.hasNext()))
+                if(((categoryRangeIndex+1) == phaseRange.end) && ((phaseRangeIndex+1) < (quint32)timelineSortPhases.count()))
                     vSpacing = 10;
 
                 //Super category
@@ -691,7 +693,7 @@ const QRectF Project::paintTimeline(bool before) {
                 categoryIndex++;
             }
 
-            if(timelineSortTags.count() > 1) {
+            if(timelineSortPhases.count() > 1) {
                 QRectF phaseRect = QRectF(phaseStart, QPointF(12, categoryStart.y() - Global::timelineTagVSpacingSeparator)).translated(Global::timelineGL->scroll.x(), 0);
                 glScissor(0, 0, Global::timelineGL->width(), Global::timelineGL->height() - Global::timelineHeaderSize.height());
                 Global::timelineGL->qglColor(Global::colorAlternateMore);
@@ -762,6 +764,10 @@ const QRectF Project::paintTimeline(bool before) {
         glDisable(GL_LINE_STIPPLE);
     }
 
+    //Text renders of tags that left the view go back to the pool
+    if(!before)
+        TagRender::recycle();
+
     return retour;
 }
 
@@ -770,16 +776,17 @@ const QRectF Project::paintViewer() {
     quint16 tagIndex = 0;
     if(Global::viewerGL) {
         //Gather information
+        tagSorter->publishViewer(viewerTags);
         if(Global::viewerSortChanged) {
-            viewerTags.clear();
+            QList<Tag*> viewerTagsToSort;
             foreach(Document *document, documents)
                 foreach(Tag *tag, document->tags)
                     if(tag->isAcceptableWithSortFilters(true))
                         if((tag->getDocument()->getFunction() == DocumentFunctionContextual) && (tag->getType() != TagTypeGlobal))
-                            viewerTags.append(tag);
+                            viewerTagsToSort.append(tag);
 
-            //Sorting criteria
-            qSort(viewerTags.begin(), viewerTags.end(), Tag::sortViewer);
+            //Sorting criteria, published on a next frame
+            tagSorter->sortViewer(viewerTagsToSort);
 
             Global::viewerSortChanged = false;
         }
@@ -855,22 +862,11 @@ bool Project::mouseTimeline(const QPointF &pos, QMouseEvent *e, bool dbl, bool s
     bool mouseOnTag = false;
     QList<void*> tagsInLasso;
     Global::selectedTagHover = 0;
-    QMapIterator<QString, QMap<QString, QMap<QString, QList<Tag*> > > > categoriesInPhasesIterator(timelineSortTags);
-    while(categoriesInPhasesIterator.hasNext()) {
-        categoriesInPhasesIterator.next();
-        QMapIterator<QString, QMap<QString, QList<Tag*> > > clustersInCategoriesIterator(categoriesInPhasesIterator.value());
-        while(clustersInCategoriesIterator.hasNext()) {
-            clustersInCategoriesIterator.next();
-            QMapIterator<QString, QList<Tag*> > tagsInClusterIterator(clustersInCategoriesIterator.value());
-            while(tagsInClusterIterator.hasNext()) {
-                tagsInClusterIterator.next();
-                foreach(Tag *tag, tagsInClusterIterator.value()) {
-                    mouseOnTag |= tag->mouseTimeline(pos, e, dbl, stay, action, press, release);
-                    if(lassoPointsDest.containsPoint(tag->getTimelineBoundingRect().translated(tag->timelinePos).translated(0, Global::timelineHeaderSize.height()).center(), Qt::WindingFill)) {
-                        tagsInLasso << tag;
-                    }
-                }
-            }
+    foreach(const TimelineSortEntry &entry, timelineSortTags) {
+        Tag *tag = entry.tag;
+        mouseOnTag |= tag->mouseTimeline(pos, e, dbl, stay, action, press, release);
+        if(lassoPointsDest.containsPoint(tag->getTimelineBoundingRect().translated(tag->timelinePos).translated(0, Global::timelineHeaderSize.height()).center(), Qt::WindingFill)) {
+            tagsInLasso << tag;
         }
     }
 
@@ -911,12 +907,9 @@ bool Project::mouseTimeline(const QPointF &pos, QMouseEvent *e, bool dbl, bool s
             for(quint16 i = 0 ; i < guiCategories.count() ; i++) {
                 if(guiCategories.at(i).first.contains(pos)) {
                     QList<Tag*> actionTags;
-                    QMapIterator<QString, QList<Tag*> > tagsInClusterIterator(timelineSortTags.value(guiCategories.at(i).second.first).value(guiCategories.at(i).second.second));
-                    while(tagsInClusterIterator.hasNext()) {
-                        tagsInClusterIterator.next();
-                        foreach(Tag *tag, tagsInClusterIterator.value())
-                            actionTags << tag;
-                    }
+                    const TimelineSortRange &categoryRange = timelineSortCategories.at(guiCategories.at(i).second);
+                    for(quint32 index = categoryRange.start ; index < categoryRange.end ; index++)
+                        actionTags << timelineSortTags.at(index).tag;
                     if(actionTags.count()) {
                         timelineFilesMenu->clear();
                         qSort(actionTags.begin(), actionTags.end(), Tag::sortColor);
@@ -942,16 +935,12 @@ bool Project::mouseTimeline(const QPointF &pos, QMouseEvent *e, bool dbl, bool s
                         }
                         QAction *retour = timelineFilesMenu->exec(QCursor::pos());
                         if(retour) {
-                            QMapIterator<QString, QList<Tag*> > tagsInClusterIterator2(timelineSortTags.value(guiCategories.at(i).second.first).value(guiCategories.at(i).second.second));
-                            while(tagsInClusterIterator2.hasNext()) {
-                                tagsInClusterIterator2.next();
-                                foreach(Tag *tag, tagsInClusterIterator2.value()) {
-                                    if(retour == tag->timelineFilesAction) {
-                                        if(tag->getDocument()->chutierItem) {
-                                            Global::chutier->setCurrentItem(tag->getDocument()->chutierItem);
-                                            Global::timelineGL->ensureVisible(tag->getTimelineBoundingRect().translated(tag->timelineDestPos).topLeft());
-                                            Global::viewerGL  ->ensureVisible(tag->getViewerBoundingRect()  .translated(tag->viewerDestPos)  .topLeft());
-                                        }
+                            foreach(Tag *tag, actionTags) {
+                                if(retour == tag->timelineFilesAction) {
+                                    if(tag->getDocument()->getChutierItem()) {
+                                        Global::chutier->setCurrentItem(tag->getDocument()->getChutierItem());
+                                        Global::timelineGL->ensureVisible(tag->getTimelineBoundingRect().translated(tag->timelineDestPos).topLeft());
+                                        Global::viewerGL  ->ensureVisible(tag->getViewerBoundingRect()  .translated(tag->viewerDestPos)  .topLeft());
                                     }
                                 }
                             }
@@ -990,3 +979,4 @@ QDomElement Project::serialize(QDomDocument &xmlDoc) const {
 void Project::deserialize(const QDomElement &xmlElement) {
     QString a = xmlElement.attribute("attribut");
 }
+
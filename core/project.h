@@ -27,15 +27,21 @@
 #include <QObject>
 #include <QMenu>
 #include <QImage>
+#include <QHash>
 #include "document.h"
 #include "cluster.h"
 #include "person.h"
+#include "taglinker.h"
+#include "tagsorter.h"
+#include "crawler.h"
+#include "projectsnapshot.h"
 
 class Project : public ProjectBase {
     Q_OBJECT
 
 public:
     explicit Project(QWidget *parent = 0);
+    ~Project();
 
 private:
     void open(const QDir &dir, const QDir &dirBase);
@@ -49,6 +55,14 @@ public:
     void addDocument(void *_document) {
         Document *document = (Document*)_document;
         documents.append(document);
+        documentsIndexKeys.insert(document, QPair<QString, QString>());
+    }
+    void indexDocument (void *_document);
+    void removeDocument(void *_document);
+    void linkChutierItem(const QString &path, void *item, bool linked = true) {
+        Document *document = getDocument(path);
+        if((document) && (linked))                                      document->chutierItem = (UiFileItem*)item;
+        else if((document) && (document->chutierItem == (UiFileItem*)item)) document->chutierItem = 0;
     }
     void addPerson(void* _person) {
         Person *person = (Person*)_person;
@@ -58,18 +72,28 @@ public:
 
 private:
     QList<Tag*> viewerTags, eventsTags;
-    QMap<QString, QMap<QString, QMap<QString, QList<Tag*> > > > timelineSortTags;
+    QVector<TimelineSortEntry> timelineSortTags;                         //Sorted by phase, sorting, cluster, color, name and version
+    QVector<TimelineSortRange> timelineSortCategories, timelineSortPhases; //Tags range per category, categories range per phase
     QMap< QPair<QString, QString>, Cluster*> timelineClusters;
     QPolygonF lassoPoints, lassoPointsDest;
+    TagLinker *tagLinker;
+    TagSorter *tagSorter;
+    bool       snapshotDirty;
+    QTime      snapshotTimer;
+private:
+    QHash<QString, Document*>      documentsByPath;
+    QMultiHash<QString, Document*> documentsByHash;
+    QHash<Document*, QPair<QString, QString> > documentsIndexKeys;
 public:
-    Document* getDocument(const QString &name) const;
+    inline Document*              getDocument         (const QString &name) const { return documentsByPath.value(name, 0); }
+    inline const QList<Document*> getDocumentsWithHash(const QString &hash) const { return documentsByHash.values(hash);   }
 
 public:
     void fireEvents();
     qreal totalTime() const;
 
 private:
-    QList< QPair<QRectF, QPair<QString, QString> > > guiCategories;
+    QList< QPair<QRectF, quint32> > guiCategories;
     QList<GlText> timelineCategories, timelinePhases;
     qreal categoryColorOpacity, categoryColorOpacityDest;
     QMenu *timelineFilesMenu;
@@ -0,0 +1,155 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "projectsnapshot.h"
+#include "interfaces/eventstreamcontroller.h"
+#include <QtConcurrentRun>
+
+QSharedPointer<const ProjectSnapshot> ProjectSnapshot::currentSnapshot;
+QMutex  ProjectSnapshot::currentSnapshotMutex;
+quint32 ProjectSnapshot::revisionCounter = 0;
+quint32 ProjectSnapshot::sourceCounter = 0;
+quint32 ProjectSnapshot::publishedSequence = 0;
+
+void ProjectSnapshot::publish(const QList<Document*> &documents) {
+    //Cheap copy on the render thread, metadata maps are implicitly shared and copied on the next write
+    ProjectSnapshotSource source;
+    source.timer.start();
+    source.sequence = ++sourceCounter;
+    source.sort     = Global::tagSortCriteria   ->getCriteriaSettings();
+    source.color    = Global::tagColorCriteria  ->getCriteriaSettings();
+    source.cluster  = Global::tagClusterCriteria->getCriteriaSettings();
+    source.text     = Global::tagTextCriteria   ->getCriteriaSettings();
+    source.filter   = Global::tagFilterCriteria ->getCriteriaSettings();
+    source.groupe   = Global::groupes           ->getCriteriaSettings();
+    source.documents.reserve(documents.count());
+    foreach(Document *document, documents) {
+        if(!document->getMetadataCount())
+            continue;
+        ProjectSnapshotSourceDocument documentSource;
+        documentSource.documentId = document->getDocumentId();
+        documentSource.path     = document->file.absoluteFilePath();
+        for(qint16 version = 0 ; version < document->getMetadataCount() ; version++)
+            documentSource.versions << document->getMetadata(version);
+        documentSource.tags.reserve(document->tags.count());
+        foreach(Tag *tag, document->tags) {
+            ProjectSnapshotSourceTag tagSource;
+            tagSource.version      = tag->getDocumentVersion();
+            tagSource.versionIndex = document->getMetadataIndexVersion(tagSource.version);
+            tagSource.timeStart    = tag->getTimeStart();
+            tagSource.timeEnd      = tag->getTimeEnd();
+            tagSource.type         = tag->getType();
+            tagSource.displayed    = (tag->isAcceptableWithSortFilters(true)) && (tag->isAcceptableWithFilterFilters(true));
+            documentSource.tags.append(tagSource);
+        }
+        source.documents.append(documentSource);
+    }
+    qint64 copyTime = source.timer.elapsed();
+    if((Global::falseProject) || (copyTime > 20))
+        qDebug("[SNAPSHOT] %d documents copied in %d ms", source.documents.count(), (int)copyTime);
+
+    //Criteria are formatted and tags sorted by a worker, like the tag sorter does
+    QtConcurrent::run(&ProjectSnapshot::build, source);
+}
+void ProjectSnapshot::build(const ProjectSnapshotSource &source) {
+    ProjectSnapshot *snapshot = new ProjectSnapshot();
+    snapshot->created         = QDateTime::currentDateTime();
+    snapshot->tagsDurationMax = 0;
+    snapshot->documents.reserve(source.documents.count());
+    QHash<QString,QString> sortCache, colorCache, clusterCache, textCache, filterCache, groupeCache;
+    foreach(const ProjectSnapshotSourceDocument &documentSource, source.documents) {
+        ProjectSnapshotDocument documentSnapshot;
+        documentSnapshot.documentId = documentSource.documentId;
+        documentSnapshot.name     = documentSource.versions.last().getNameCache;
+        documentSnapshot.type     = documentSource.versions.last().getTypeStrCache;
+        documentSnapshot.path     = documentSource.path;
+        documentSnapshot.versions = documentSource.versions;
+
+        //Criteria only depend on the version, formatted once for all the tags of a version (same rules as Metadata::getCriteria*Formated)
+        QVector<ProjectSnapshotTag> versionCriterias(documentSource.versions.count());
+        for(qint16 version = 0 ; version < documentSource.versions.count() ; version++) {
+            const QMetaDictionnay &metadata = documentSource.versions.at(version);
+            ProjectSnapshotTag &criterias = versionCriterias[version];
+            bool render = (metadata.getFunctionCache == DocumentFunctionRender);
+            QString sort;
+            if((render) && (source.sort.asDate))    sort = Metadata::getMetadata(metadata, source.sort.tagNameCategory, source.sort.tagName).toString(source.sort.left, source.sort.leftLength) + "\n" + metadata.getNameCache;
+            else if(render)                         sort = "\n" + metadata.getNameCache;
+            else                                    sort = source.sort.getCriteria(metadata);
+            criterias.sort = source.sort.getCriteriaFormated(sort, sortCache);
+            if((source.sort.asDate) && (criterias.sort.isEmpty()))
+                criterias.sort = Metadata::tr("Undated");
+            if(!render) {
+                criterias.color   = source.color  .getCriteriaFormated(source.color  .getCriteria(metadata), colorCache);
+                criterias.cluster = source.cluster.getCriteriaFormated(source.cluster.getCriteria(metadata), clusterCache);
+                criterias.text    = source.text   .getCriteriaFormated(source.text   .getCriteria(metadata), textCache);
+                criterias.filter  = source.filter .getCriteriaFormated(source.filter .getCriteria(metadata), filterCache);
+            }
+            criterias.groupe = source.groupe.getCriteriaFormated(source.groupe.getCriteria(metadata), groupeCache);
+        }
+
+        foreach(const ProjectSnapshotSourceTag &tagSource, documentSource.tags) {
+            ProjectSnapshotTag tagSnapshot = versionCriterias.at(tagSource.versionIndex);
+            tagSnapshot.document  = snapshot->documents.count();
+            tagSnapshot.version   = tagSource.version;
+            tagSnapshot.timeStart = tagSource.timeStart;
+            tagSnapshot.timeEnd   = tagSource.timeEnd;
+            tagSnapshot.type      = tagSource.type;
+            tagSnapshot.displayed = tagSource.displayed;
+            snapshot->tagsDurationMax = qMax(snapshot->tagsDurationMax, tagSnapshot.timeEnd - tagSnapshot.timeStart);
+            snapshot->tags.append(tagSnapshot);
+        }
+        snapshot->documents.append(documentSnapshot);
+    }
+    qStableSort(snapshot->tags.begin(), snapshot->tags.end(), ProjectSnapshotTag::sortByStart);
+
+    //Swap, requests in progress keep the previous snapshot alive. Dropped if a newer one was published or the project closed meanwhile
+    currentSnapshotMutex.lock();
+    if(source.sequence <= publishedSequence) {
+        currentSnapshotMutex.unlock();
+        delete snapshot;
+        return;
+    }
+    publishedSequence  = source.sequence;
+    snapshot->revision = ++revisionCounter;
+    currentSnapshot = QSharedPointer<const ProjectSnapshot>(snapshot);
+    currentSnapshotMutex.unlock();
+    EventStreamController::publishDocuments(snapshot->revision, snapshot->documents.count(), snapshot->tags.count());
+    if((Global::falseProject) || (source.timer.elapsed() > 50))
+        qDebug("[SNAPSHOT] revision %d : %d documents, %d tags in %d ms", snapshot->revision, snapshot->documents.count(), snapshot->tags.count(), source.timer.elapsed());
+}
+void ProjectSnapshot::clear() {
+    QMutexLocker locker(&currentSnapshotMutex);
+    publishedSequence = sourceCounter;
+    currentSnapshot.clear();
+}
+QSharedPointer<const ProjectSnapshot> ProjectSnapshot::current() {
+    QMutexLocker locker(&currentSnapshotMutex);
+    return currentSnapshot;
+}
+
+const QVector<ProjectSnapshotTag>::const_iterator ProjectSnapshot::tagsFrom(qreal time) const {
+    //First tag that may still be running at this time
+    ProjectSnapshotTag bound;
+    bound.timeStart = time - tagsDurationMax;
+    return qLowerBound(tags.constBegin(), tags.constEnd(), bound, ProjectSnapshotTag::sortByStart);
+}
@@ -0,0 +1,100 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROJECTSNAPSHOT_H
+#define PROJECTSNAPSHOT_H
+
+#include <QSharedPointer>
+#include <QVector>
+#include <QMutex>
+#include <QTime>
+#include "document.h"
+#include "sorting.h"
+
+class ProjectSnapshotTag {
+public:
+    quint32 document;
+    qint16  version;
+    qreal   timeStart, timeEnd;
+    TagType type;
+    bool    displayed;
+    QString sort, color, cluster, text, filter, groupe;
+public:
+    static bool sortByStart(const ProjectSnapshotTag &first, const ProjectSnapshotTag &second) { return first.timeStart < second.timeStart; }
+};
+
+class ProjectSnapshotDocument {
+public:
+    quint32 documentId;     //Stable id, matched with full-text index results
+    QString name, path, type;
+    QList<QMetaDictionnay> versions;
+};
+
+class ProjectSnapshotSourceTag {
+public:
+    qint16  version, versionIndex;
+    qreal   timeStart, timeEnd;
+    TagType type;
+    bool    displayed;
+};
+
+class ProjectSnapshotSourceDocument {
+public:
+    quint32 documentId;
+    QString path;
+    QList<QMetaDictionnay> versions;    //Implicitly shared with the document
+    QVector<ProjectSnapshotSourceTag> tags;
+};
+
+class ProjectSnapshotSource {
+public:
+    quint32 sequence;
+    QTime   timer;
+    QVector<ProjectSnapshotSourceDocument> documents;
+    SortingCriteria sort, color, cluster, text, filter, groupe;
+};
+
+class ProjectSnapshot {
+public:
+    quint32   revision;
+    QDateTime created;
+    QVector<ProjectSnapshotDocument> documents;
+    QVector<ProjectSnapshotTag>      tags;          //Sorted by start time
+    qreal     tagsDurationMax;
+public:
+    const QVector<ProjectSnapshotTag>::const_iterator tagsFrom(qreal time) const;
+
+public:
+    static void publish(const QList<Document*> &documents);
+    static void clear();
+    static QSharedPointer<const ProjectSnapshot> current();
+private:
+    static void build(const ProjectSnapshotSource &source);
+private:
+    static QSharedPointer<const ProjectSnapshot> currentSnapshot;
+    static QMutex  currentSnapshotMutex;
+    static quint32 revisionCounter;
+    static quint32 sourceCounter, publishedSequence;
+};
+
+#endif // PROJECTSNAPSHOT_H
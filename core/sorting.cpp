@@ -23,6 +23,7 @@
 
 #include "sorting.h"
 #include "ui_sorting.h"
+#include "core/metadata.h"
 
 Sorting::Sorting(const QString &title, quint16 index, bool _needWord, bool _isHorizontal, QWidget *parent) :
     QWidget(parent, Qt::Tool | Qt::FramelessWindowHint),
@@ -56,6 +57,7 @@ Sorting::Sorting(const QString &title, quint16 index, bool _needWord, bool _isHo
     ui->filter->setCurrentIndex(index);
     ui->checks->sortByColumn(0, Qt::AscendingOrder);
     isUpdating = false;
+    criteriaFormatedRealCacheVersion = 1;
     actionSelection();
 }
 void Sorting::init() {
@@ -98,6 +100,7 @@ void Sorting::action() {
         ui->uncheckAll->setVisible(needWordValue);
         ui->sorting   ->setVisible(needWordValue);
     }
+    updateMatches();
     if(isUpdating)
         return;
 
@@ -175,6 +178,7 @@ void Sorting::action() {
     for(quint16 i = 0 ; i < ui->checks->topLevelItemCount() ; i++)
         if((!ui->checks->topLevelItem(i)->isHidden()) && (ui->checks->topLevelItem(i)->checkState(1) == Qt::Unchecked))
             text2 = ui->filter->currentText();
+    criteriaFormatedRealCacheVersion++;
     emit(actionned(ui->filter->currentText(), text2));
 }
 void Sorting::actionSelection() {
@@ -190,18 +194,7 @@ void Sorting::actionSelection() {
 
 
 const QString Sorting::getCriteria(const QString &criteria) const {
-    if(criteria.isEmpty())
-        return QString();
-
-    if(asTimeline)
-        return 0;
-
-    bool asNumberGuess = false;
-    qreal criteriaReal = toDouble(criteria, &asNumberGuess);
-    if((!asDate) && (asNumberGuess))
-        return QString("%1").arg(criteriaReal, 25, 'f', 5, QChar('0')).trimmed();
-
-    return criteria.toLower();
+    return SortingCriteria::getCriteria(criteria, asDate, asTimeline);
 }
 const QString Sorting::getCriteriaFormated(qreal criteria) const {
     if(asTimeline)
@@ -225,20 +218,43 @@ qreal Sorting::getCriteriaFormatedReal(const QString &criteria, qreal timeValue)
     if((!asDate) && (asNumberGuess))
         val = (criteriaReal - asNumberRange.first) / (asNumberRange.second - asNumberRange.first) * 60.;
     else {
-        val = (qreal)criteriaFormatedRealCacheRaw.indexOf(criteria);
-        if(val < 0) val = criteriaFormatedRealCacheRaw.count();
+        val = (qreal)criteriaFormatedRealCacheOrdinal.value(criteria, criteriaFormatedRealCacheRaw.count());
         val *= 5;
     }
 
     return val;
 }
-const QString Sorting::getCriteriaFormated(const QString &_criteria) {
+const QString Sorting::getCriteriaFormated(const QString &criteria) {
+    return SortingCriteria::getCriteriaFormated(criteria, asDate, leftLength, criteriaFormatedCache);
+}
+const QString SortingCriteria::getCriteria(const QMetaDictionnay &metadata) const {
+    return getCriteria(Metadata::getMetadata(metadata, tagNameCategory, tagName).toString(left, leftLength), asDate, asTimeline);
+}
+const QString SortingCriteria::getCriteriaFormated(const QString &criteria, QHash<QString,QString> &cache) const {
+    return getCriteriaFormated(criteria, asDate, leftLength, cache);
+}
+const QString SortingCriteria::getCriteria(const QString &criteria, bool asDate, bool asTimeline) {
+    if(criteria.isEmpty())
+        return QString();
+
+    if(asTimeline)
+        return 0;
+
+    bool asNumberGuess = false;
+    qreal criteriaReal = Sorting::toDouble(criteria, &asNumberGuess);
+    if((!asDate) && (asNumberGuess))
+        return QString("%1").arg(criteriaReal, 25, 'f', 5, QChar('0')).trimmed();
+
+    return criteria.toLower();
+}
+const QString SortingCriteria::getCriteriaFormated(const QString &_criteria, bool asDate, qint16 leftLength, QHash<QString,QString> &cache) {
+    //Only depends on its parameters, so the snapshot worker formats with its own cache
     if(_criteria.isEmpty())
         return _criteria;
 
 
     bool asNumberGuess = false;
-    qreal criteriaReal = toDouble(_criteria, &asNumberGuess);
+    qreal criteriaReal = Sorting::toDouble(_criteria, &asNumberGuess);
     if((!asDate) && (asNumberGuess))
         return QString("%1").arg(criteriaReal, 'f').trimmed();
 
@@ -249,18 +265,18 @@ const QString Sorting::getCriteriaFormated(const QString &_criteria) {
         suffix   = criteria.right(criteria.length() - index - 1);
     }
     if(asDate) {
-        if(criteriaFormatedCache.contains(criteria))
-            return criteriaFormatedCache.value(criteria);
+        if(cache.contains(criteria))
+            return cache.value(criteria);
         else {
             QString retour;
             if     (criteria.length() <= 3)   retour = criteria;
-            else if(criteria.length() <= 4)   retour = tr("%1's").arg(criteria.left(4), -4, '0');
+            else if(criteria.length() <= 4)   retour = Sorting::tr("%1's").arg(criteria.left(4), -4, '0');
             else if(criteria.length() <= 8)   retour = QDateTime::fromString(criteria, QString("yyyy:MM:dd hh:mm:ss").left(criteria.length())).toString("MMMM yyyy");
             else if(criteria.length() <= 11)  retour = QDateTime::fromString(criteria, QString("yyyy:MM:dd hh:mm:ss").left(criteria.length())).toString("dddd dd MMMM yyyy");
             else if(criteria.length() <= 13)  retour = QDateTime::fromString(criteria, QString("yyyy:MM:dd hh:mm:ss").left(criteria.length())).toString("dddd dd MMMM yyyy, hh") + "h";
             else if(criteria.length() <= 15)  retour = QDateTime::fromString(criteria, QString("yyyy:MM:dd hh:mm:ss").left(criteria.length())).toString("dddd dd MMMM yyyy, hh:mm");
             else                              retour = QDateTime::fromString(criteria, QString("yyyy:MM:dd hh:mm:ss").left(criteria.length())).toString("dddd dd MMMM yyyy, hh:mm:ss");
-            criteriaFormatedCache.insert(criteria, retour);
+            cache.insert(criteria, retour);
             return retour + suffix;
         }
     }
@@ -268,6 +284,16 @@ const QString Sorting::getCriteriaFormated(const QString &_criteria) {
         return criteria + suffix + "...";
     return criteria + suffix;
 }
+const SortingCriteria Sorting::getCriteriaSettings() const {
+    SortingCriteria criteria;
+    criteria.tagNameCategory = tagNameCategory;
+    criteria.tagName         = tagName;
+    criteria.left            = left;
+    criteria.leftLength      = leftLength;
+    criteria.asDate          = asDate;
+    criteria.asTimeline      = asTimeline;
+    return criteria;
+}
 
 
 
@@ -296,40 +322,49 @@ bool Sorting::isAcceptable(bool strongCheck, const QString &_criteria) const {
                 return false;
         }
     }
-    if(!ui->matches->text().isEmpty()) {
-        QStringList matches = ui->matches->text().toLower().split(",", QString::SkipEmptyParts);
-        foreach(const QString &match, matches) {
-            QRegExp regexp;
-            regexp.setPatternSyntax(QRegExp::Wildcard);
-            regexp.setPattern(match.trimmed());
-
-            QStringList criterias = _criteria.toLower().split(",", QString::SkipEmptyParts);
+    if((!matchesRegExps.isEmpty()) || (!matchesPlain.isEmpty())) {
+        QStringList criterias = _criteria.toLower().split(",", QString::SkipEmptyParts);
+        foreach(const QString &match, matchesPlain)
+            foreach(const QString &criteria, criterias)
+                if(criteria.contains(match))
+                    return true;
+
+        foreach(const QRegExp &regexp, matchesRegExps)
             foreach(const QString &criteria, criterias)
                 if(regexp.indexIn(criteria.trimmed()) >= 0)
                     return true;
-        }
         return false;
     }
     return true;
 }
 const QString Sorting::getAcceptableWithFilters(const QString &_criteria) const {
     QString retour;
-    if(!ui->matches->text().isEmpty()) {
-        QStringList matches = ui->matches->text().toLower().split(",", QString::SkipEmptyParts);
-        foreach(const QString &match, matches) {
-            QRegExp regexp;
-            regexp.setPatternSyntax(QRegExp::Wildcard);
-            regexp.setPattern(match.trimmed());
-
-            QStringList criterias = _criteria.toLower().split(",", QString::SkipEmptyParts);
+    if((!matchesRegExps.isEmpty()) || (!matchesPlain.isEmpty())) {
+        QStringList criterias = _criteria.toLower().split(",", QString::SkipEmptyParts);
+        foreach(const QString &match, matchesPlain)
+            foreach(const QString &criteria, criterias)
+                if(criteria.contains(match))
+                    return criteria.trimmed();
+        foreach(const QRegExp &regexp, matchesRegExps)
             foreach(const QString &criteria, criterias)
                 if(regexp.indexIn(criteria.trimmed()) >= 0)
                     return criteria.trimmed();
-        }
         return retour;
     }
     return _criteria;
 }
+void Sorting::updateMatches() {
+    //Patterns are compiled once, plain patterns are a substring test and need no regexp
+    matchesRegExps.clear();
+    matchesPlain.clear();
+    QStringList matches = ui->matches->text().toLower().split(",", QString::SkipEmptyParts);
+    foreach(const QString &match, matches) {
+        if(MetadataIndex::isWildcard(match.trimmed()))
+            matchesRegExps << QRegExp(match.trimmed(), Qt::CaseSensitive, QRegExp::Wildcard);
+        else if(!match.trimmed().isEmpty())
+            matchesPlain << match.trimmed();
+    }
+}
 
 const QString Sorting::getMatchName() const {
     return ui->matches->text();
@@ -340,17 +375,13 @@ Sorting::~Sorting() {
 }
 
 void Sorting::addCheckStart() {
-    isUpdating = true;
+    //Values are aggregated first, the widget only receives the difference in addCheckEnd()
+    checksTimer.start();
+    checksAggregated.clear();
+    checksAdded = 0;
     criteriaFormatedRealCacheRaw.clear();
     criteriaFormatedRealCacheFormated.clear();
-    for(quint16 i = 0 ; i < ui->checks->topLevelItemCount() ; i++) {
-        if(!ui->checks->topLevelItem(i)->isHidden())
-            ui->checks->topLevelItem(i)->setHidden(true);
-    }
-    ui->checks->setColumnHidden(0, true);
-    ui->sorting->setVisible(false);
-    ui->checks->setColumnHidden(2, true);
-    isUpdating = false;
+    criteriaFormatedRealCacheOrdinal.clear();
 }
 void Sorting::addCheck(const QString &sorting, const QString &sortingFormated, const QString &_complement) {
     if((sorting.isEmpty()) && (sortingFormated.isEmpty()))
@@ -360,38 +391,83 @@ void Sorting::addCheck(const QString &sorting, const QString &sortingFormated, c
     if(_complement != sortingFormated)
         complement = _complement;
 
+    checksAdded++;
+    QHash<QString, SortingCheck>::iterator check = checksAggregated.find(sorting);
+    if(check == checksAggregated.end()) {
+        SortingCheck newCheck;
+        newCheck.sortingFormated = sortingFormated;
+        newCheck.complement      = complement;
+        checksAggregated.insert(sorting, newCheck);
+    }
+    else {
+        if(!sortingFormated.isEmpty())
+            check.value().sortingFormated = sortingFormated;
+        check.value().complement = complement;
+    }
+}
+void Sorting::addCheckEnd() {
+    qint64 aggregationTime = checksTimer.elapsed();
+    quint32 checksInserted = 0, checksRemoved = 0, checksUpdated = 0;
+
+    //Apply the difference to the widget
     isUpdating = true;
-    for(quint16 i = 0 ; i < ui->checks->topLevelItemCount() ; i++) {
-        if(ui->checks->topLevelItem(i)->text(0) == sorting) {
-            if(ui->checks->topLevelItem(i)->isHidden())                    ui->checks->topLevelItem(i)->setHidden(false);
-            if((!sortingFormated.isEmpty()) && (ui->checks->topLevelItem(i)->text(1) != sortingFormated))
-                ui->checks->topLevelItem(i)->setText(1, sortingFormated);
-            if(ui->checks->topLevelItem(i)->text(2) != complement)         ui->checks->topLevelItem(i)->setText(2, complement);
-            if(!complement.isEmpty()) {
-                ui->checks->setColumnHidden(2, false);
-                ui->sorting->setVisible(true);
-                ui->checks->setColumnWidth(0, 150);
+    bool hasComplement = false;
+    QMutableHashIterator<QString, QTreeWidgetItem*> checksItemsIterator(checksItems);
+    while(checksItemsIterator.hasNext()) {
+        checksItemsIterator.next();
+        if((!checksAggregated.contains(checksItemsIterator.key())) && (!checksItemsIterator.value()->isHidden())) {
+            checksItemsIterator.value()->setHidden(true);
+            checksRemoved++;
+        }
+    }
+    QHashIterator<QString, SortingCheck> checksAggregatedIterator(checksAggregated);
+    while(checksAggregatedIterator.hasNext()) {
+        checksAggregatedIterator.next();
+        const SortingCheck &check = checksAggregatedIterator.value();
+        hasComplement |= (!check.complement.isEmpty());
+        QTreeWidgetItem *checkItem = checksItems.value(checksAggregatedIterator.key(), 0);
+        if(checkItem) {
+            bool updated = false;
+            if(checkItem->isHidden()) {
+                checkItem->setHidden(false);
+                updated = true;
             }
-            isUpdating = false;
-            return;
+            if((!check.sortingFormated.isEmpty()) && (checkItem->text(1) != check.sortingFormated)) {
+                checkItem->setText(1, check.sortingFormated);
+                updated = true;
+            }
+            if(checkItem->text(2) != check.complement) {
+                checkItem->setText(2, check.complement);
+                updated = true;
+            }
+            if(updated)
+                checksUpdated++;
+        }
+        else {
+            checkItem = new QTreeWidgetItem(ui->checks, QStringList() << checksAggregatedIterator.key() << check.sortingFormated << check.complement);
+            checkItem->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
+            checkItem->setCheckState(1, Qt::Checked);
+            checksItems.insert(checksAggregatedIterator.key(), checkItem);
+            checksInserted++;
         }
     }
-
-    QTreeWidgetItem *checkItem = new QTreeWidgetItem(ui->checks, QStringList() << sorting << sortingFormated << complement);
-    checkItem->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
-    checkItem->setCheckState(1, Qt::Checked);
-    if(!complement.isEmpty()) {
-        ui->checks->setColumnHidden(2, false);
-        ui->sorting->setVisible(true);
+    ui->checks->setColumnHidden(0, true);
+    ui->checks->setColumnHidden(2, !hasComplement);
+    ui->sorting->setVisible(hasComplement);
+    if(hasComplement)
         ui->checks->setColumnWidth(0, 150);
-    }
     isUpdating = false;
-}
-void Sorting::addCheckEnd() {
+
+    qint64 diffTime = checksTimer.elapsed() - aggregationTime;
+    if((Global::falseProject) || ((aggregationTime + diffTime) > 50))
+        qDebug("[SORTING] %s : %d checks aggregated into %d values in %d ms, widget diff (+%d -%d ~%d) in %d ms", qPrintable(ui->title->text()), checksAdded, checksAggregated.count(), (int)aggregationTime, checksInserted, checksRemoved, checksUpdated, (int)diffTime);
+
     asNumber      = (!asDate);
     asNumberRange = qMakePair(9999999., -9999999.);
     for(quint16 i = 0 ; i < ui->checks->topLevelItemCount() ; i++) {
         if((!ui->checks->topLevelItem(i)->isHidden()) && (ui->checks->topLevelItem(i)->checkState(1) == Qt::Checked)) {
+            if(!criteriaFormatedRealCacheOrdinal.contains(ui->checks->topLevelItem(i)->text(0)))
+                criteriaFormatedRealCacheOrdinal.insert(ui->checks->topLevelItem(i)->text(0), criteriaFormatedRealCacheRaw.count());
             criteriaFormatedRealCacheRaw << ui->checks->topLevelItem(i)->text(0);
             if(ui->checks->topLevelItem(i)->text(1).isEmpty())  criteriaFormatedRealCacheFormated << ui->checks->topLevelItem(i)->text(0);
             else                                                criteriaFormatedRealCacheFormated << ui->checks->topLevelItem(i)->text(1);
@@ -406,6 +482,7 @@ void Sorting::addCheckEnd() {
             }
         }
     }
+    criteriaFormatedRealCacheVersion++;
 }
 
 
@@ -25,6 +25,8 @@
 #define SORTING_H
 
 #include <QWidget>
+#include <QSet>
+#include <QRegExp>
 #include "qmath.h"
 #include "misc/options.h"
 
@@ -32,6 +34,26 @@ namespace Ui {
 class Sorting;
 }
 
+class QMetaDictionnay;
+
+class SortingCriteria {
+public:
+    QString tagNameCategory, tagName;
+    qint16  left, leftLength;
+    bool    asDate, asTimeline;
+public:
+    const QString getCriteria(const QMetaDictionnay &metadata) const;
+    const QString getCriteriaFormated(const QString &criteria, QHash<QString,QString> &cache) const;
+public:
+    static const QString getCriteria(const QString &criteria, bool asDate, bool asTimeline);
+    static const QString getCriteriaFormated(const QString &criteria, bool asDate, qint16 leftLength, QHash<QString,QString> &cache);
+};
+
+class SortingCheck {
+public:
+    QString sortingFormated, complement;
+};
+
 class Sorting : public QWidget {
     Q_OBJECT
     
@@ -56,6 +78,7 @@ public:
     inline       bool    isTimeline()         const { return asTimeline;      }
     inline       bool    isNumber()           const { return asNumber;        }
     inline       bool    isDate()             const { return asDate;          }
+    const SortingCriteria getCriteriaSettings() const;
 
 public:
     QCheckBox *getLinkedTags() const;
@@ -69,15 +92,23 @@ protected:
 signals:
     void displayed(bool);
 
+private:
+    QList<QRegExp> matchesRegExps;
+    QStringList    matchesPlain;
+    void updateMatches();
+
 private:
     QHash<QString,QString> criteriaFormatedCache;
     QStringList criteriaFormatedRealCacheRaw, criteriaFormatedRealCacheFormated;
+    QHash<QString, quint32> criteriaFormatedRealCacheOrdinal;
+    quint32 criteriaFormatedRealCacheVersion;
 
 public:
     const QString getCriteria(const QString &criteria) const;
     const QString getCriteriaFormated(const QString &criteria);
     const QString getCriteriaFormated(qreal criteria) const;
     qreal getCriteriaFormatedReal(const QString &criteria, qreal timeValue) const;
+    inline quint32 getCriteriaFormatedRealVersion() const { return criteriaFormatedRealCacheVersion; }
     inline qreal getCriteriaFormatedRealDuration(qreal durationValue) const {
         if(asTimeline)  return durationValue;
         else            return 0;
@@ -86,6 +117,11 @@ public:
     const QString getAcceptableWithFilters(const QString &criteria) const;
     const QString getMatchName() const;
 
+private:
+    QHash<QString, SortingCheck>     checksAggregated;
+    QHash<QString, QTreeWidgetItem*> checksItems;
+    quint32 checksAdded;
+    QTime   checksTimer;
 public:
     void addCheckStart();
     void addCheck(const QString& sorting, const QString &sortingFormated, const QString &complement);
@@ -22,6 +22,65 @@
 */
 
 #include "tag.h"
+#include "interfaces/eventstreamcontroller.h"
+
+quint32           TagRender::frame               = 0;
+quint32           TagRender::framesBeforeRecycle = 100;
+QList<TagRender*> TagRender::used;
+QList<TagRender*> TagRender::available;
+quint32           Tag::instances                 = 0;
+ObjectPool        Tag::pool(sizeof(Tag));
+
+TagRender::TagRender() {
+    owner     = 0;
+    lastFrame = 0;
+    viewerTimeText          .setStyle(QSize( 70, Global::viewerTagHeight), Qt::AlignCenter,    Global::font);
+    viewerDocumentText      .setStyle(QSize(300, Global::viewerTagHeight), Qt::AlignVCenter,   Global::font);
+    timelineTimeStartText   .setStyle(QSize( 70, Global::timelineTagHeightDest), Qt::AlignRight | Qt::AlignVCenter, Global::fontSmall);
+    timelineTimeEndText     .setStyle(QSize( 70, Global::timelineTagHeightDest), Qt::AlignLeft  | Qt::AlignVCenter, Global::fontSmall);
+    timelineTimeDurationText.setStyle(QSize(100, Global::timelineTagHeightDest), Qt::AlignCenter, Global::fontSmall);
+    timelineDocumentText    .setStyle(QSize(300, Global::timelineTagHeightDest), Qt::AlignCenter, Global::fontSmall);
+}
+TagRender* TagRender::acquire(TagRender **owner) {
+    //Recycled renders keep their images and GL textures, a new text only repaints the image
+    TagRender *render = 0;
+    if(available.count())   render = available.takeLast();
+    else                    render = new TagRender();
+    render->owner = owner;
+    used.append(render);
+    return render;
+}
+void TagRender::release(TagRender *render) {
+    if(render->owner)
+        *render->owner = 0;
+    render->owner = 0;
+    used.removeOne(render);
+    available.append(render);
+}
+void TagRender::recycle() {
+    frame++;
+    for(qint32 i = used.count()-1 ; i >= 0 ; i--) {
+        TagRender *render = used.at(i);
+        if((frame - render->lastFrame) > framesBeforeRecycle) {
+            if(render->owner)
+                *render->owner = 0;
+            render->owner = 0;
+            used.removeAt(i);
+            available.append(render);
+        }
+    }
+}
+void TagRender::report(quint32 tagCount) {
+    TagRender *render = (used.count())?(used.first()):((available.count())?(available.first()):(0));
+    quint32 renderSize = sizeof(TagRender);
+    if(render)
+        renderSize += render->viewerTimeText.image.byteCount() + render->viewerDocumentText.image.byteCount() + render->timelineTimeStartText.image.byteCount() + render->timelineTimeEndText.image.byteCount() + render->timelineTimeDurationText.image.byteCount() + render->timelineDocumentText.image.byteCount();
+    quint32 renderCount = used.count() + available.count();
+    qreal   tagSize     = sizeof(Tag) + (tagCount?((qreal)renderCount * renderSize / tagCount):(0));
+    qDebug("[TAGS] %d tags, %d bytes per tag core, %d renders allocated (%d bytes each) => %d bytes per tag", tagCount, (int)sizeof(Tag), renderCount, renderSize, (int)tagSize);
+    qDebug("[TAGS] 100000 tags => %.1f MB (%.1f MB with a render per tag)", (100000. * sizeof(Tag) + (qreal)renderCount * renderSize) / 1048576., (100000. * (sizeof(Tag) + renderSize)) / 1048576.);
+}
+
 
 Tag::Tag(DocumentBase *_document, qint16 _documentVersion) :
     QObject(_document) {
@@ -35,19 +94,21 @@ Tag::Tag(DocumentBase *_document, qint16 _documentVersion) :
     viewerFirstPos = timelineFirstPos = true;
     viewerFirstPosVisible = timelineFirstPosVisible = false;
     blinkTime         = 0;
+    timelineHorizontalPos        = 0;
+    timelineHorizontalPosVersion = 0;
     timelineFilesAction = 0;
     timeStart = timeEnd = timeMediaOffset = 0;
     tagScale     = 0;
     tagDestScale = 1;
     displayText  = "";
     linkMove = linkMoveDest = 0.66;
-
-    viewerTimeText          .setStyle(QSize( 70, Global::viewerTagHeight), Qt::AlignCenter,    Global::font);
-    viewerDocumentText      .setStyle(QSize(300, Global::viewerTagHeight), Qt::AlignVCenter,   Global::font);
-    timelineTimeStartText   .setStyle(QSize( 70, Global::timelineTagHeightDest), Qt::AlignRight | Qt::AlignVCenter, Global::fontSmall);
-    timelineTimeEndText     .setStyle(QSize( 70, Global::timelineTagHeightDest), Qt::AlignLeft  | Qt::AlignVCenter, Global::fontSmall);
-    timelineTimeDurationText.setStyle(QSize(100, Global::timelineTagHeightDest), Qt::AlignCenter, Global::fontSmall);
-    timelineDocumentText    .setStyle(QSize(300, Global::timelineTagHeightDest), Qt::AlignCenter, Global::fontSmall);
+    render       = 0;
+    instances++;
+}
+Tag::~Tag() {
+    if(render)
+        TagRender::release(render);
+    instances--;
 }
 
 void Tag::init() {
@@ -175,8 +236,10 @@ bool Tag::fireEvents() {
         if(getType() != TagTypeGlobal)
             oscValue = 0;
     }
-    if(oscValue >= 0)
+    if(oscValue >= 0) {
+        EventStreamController::publishCue(this, (oscValue == 1));
         Global::udp->send("127.0.0.1", 57120, "/rekall", QList<QVariant>() << document->getTypeStr(version) << document->getAuthor(version) << document->getName(version) << getTimeStart() << getTimeEnd() << oscValue << document->baseColor.redF() << document->baseColor.greenF() << document->baseColor.blueF() << document->baseColor.alphaF());
+    }
 
     if((oscValue == 1) && (document->getType() == DocumentTypeMarker)) {
         Global::mainWindow->changeAnnotation(this);
@@ -194,7 +257,15 @@ const QRectF Tag::paintTimeline(bool before) {
             timelineBoundingRect = QRectF(QPointF(Global::timelineGL->scroll.x()-Global::timelineGlobalDocsWidth, 0), QSizeF(qMax(Global::timelineTagHeight, getDuration(true) * Global::timeUnit), Global::timelineTagHeight));
             //timelineBoundingRect = QRectF(QPointF(Global::timelineGL->scroll.x()-Global::timelineGlobalDocsWidth, 0), QSizeF(getDuration(true) * Global::timeUnit, Global::timelineTagHeight));
         else {
-            qreal pos   = Global::tagHorizontalCriteria->getCriteriaFormatedReal(getCriteriaHorizontal(this), getTimeStart());
+            //Horizontal position only depends on the criteria, computed again when they change
+            qreal pos = getTimeStart();
+            if(!Global::tagHorizontalCriteria->isTimeline()) {
+                if(timelineHorizontalPosVersion != Global::tagHorizontalCriteria->getCriteriaFormatedRealVersion()) {
+                    timelineHorizontalPos        = Global::tagHorizontalCriteria->getCriteriaFormatedReal(getCriteriaHorizontal(this), getTimeStart());
+                    timelineHorizontalPosVersion = Global::tagHorizontalCriteria->getCriteriaFormatedRealVersion();
+                }
+                pos = timelineHorizontalPos;
+            }
             qreal width = Global::tagHorizontalCriteria->getCriteriaFormatedRealDuration(getDuration(true));
             timelineBoundingRect = QRectF(QPointF(pos * Global::timeUnit, 0), QSizeF(qMax(Global::timelineTagHeight, width * Global::timeUnit), Global::timelineTagHeight));
             //timelineBoundingRect = QRectF(QPointF(pos * Global::timeUnit, 0), QSizeF(width * Global::timeUnit, Global::timelineTagHeight));
@@ -308,30 +379,32 @@ const QRectF Tag::paintTimeline(bool before) {
                 Global::timelineGL->qglColor(realTimeColor);
 
                 if(Global::selectedTags.contains(this)) {
-                    textPos = QPoint(timelineBoundingRect.left() - 2 - timelineTimeStartText.size.width(), 1 + timelineBoundingRect.center().y() - timelineTimeStartText.size.height()/2);
-                    timelineTimeStartText.drawText(Sorting::timeToString(getTimeStart()), textPos);
+                    TagRender *tagRender = getRender();
+                    textPos = QPoint(timelineBoundingRect.left() - 2 - tagRender->timelineTimeStartText.size.width(), 1 + timelineBoundingRect.center().y() - tagRender->timelineTimeStartText.size.height()/2);
+                    tagRender->timelineTimeStartText.drawText(Sorting::timeToString(getTimeStart()), textPos);
 
                     if(getType() == TagTypeContextualTime) {
-                        textPos = QPoint(timelineBoundingRect.right() + 2, 1 + timelineBoundingRect.center().y() - timelineTimeEndText.size.height()/2);
+                        textPos = QPoint(timelineBoundingRect.right() + 2, 1 + timelineBoundingRect.center().y() - tagRender->timelineTimeEndText.size.height()/2);
                         if(Global::tagHorizontalCriteria->isTimeline())
-                            timelineTimeEndText.drawText(Sorting::timeToString(getTimeEnd()), textPos);
+                            tagRender->timelineTimeEndText.drawText(Sorting::timeToString(getTimeEnd()), textPos);
                         else
-                            timelineTimeEndText.drawText(Sorting::timeToString(getTimeEnd()) + " (" + Sorting::timeToString(getDuration()) + ")", textPos);
+                            tagRender->timelineTimeEndText.drawText(Sorting::timeToString(getTimeEnd()) + " (" + Sorting::timeToString(getDuration()) + ")", textPos);
 
                         if(isTagLastVersion(this))
                             Global::timelineGL->qglColor(Qt::white);
-                        textPos = QPoint(timelineBoundingRect.center().x() - timelineTimeDurationText.size.width()/2, 1 + timelineBoundingRect.center().y() - timelineTimeDurationText.size.height()/2);
+                        textPos = QPoint(timelineBoundingRect.center().x() - tagRender->timelineTimeDurationText.size.width()/2, 1 + timelineBoundingRect.center().y() - tagRender->timelineTimeDurationText.size.height()/2);
                         if(document->getFunction(version) == DocumentFunctionRender) {
-                            if(getTimeMediaOffset() > 0)    timelineTimeDurationText.drawText(Sorting::timeToString(getDuration()) + " / " + Sorting::timeToString(document->getMediaDuration()) + tr(" (-") + Sorting::timeToString(getTimeMediaOffset()) + ")", textPos);
-                            else                            timelineTimeDurationText.drawText(Sorting::timeToString(getDuration()) + " / " + Sorting::timeToString(document->getMediaDuration()), textPos);
+                            if(getTimeMediaOffset() > 0)    tagRender->timelineTimeDurationText.drawText(Sorting::timeToString(getDuration()) + " / " + Sorting::timeToString(document->getMediaDuration()) + tr(" (-") + Sorting::timeToString(getTimeMediaOffset()) + ")", textPos);
+                            else                            tagRender->timelineTimeDurationText.drawText(Sorting::timeToString(getDuration()) + " / " + Sorting::timeToString(document->getMediaDuration()), textPos);
                         }
                         else if(Global::tagHorizontalCriteria->isTimeline())
-                            timelineTimeDurationText.drawText(Sorting::timeToString(getDuration()), textPos);
+                            tagRender->timelineTimeDurationText.drawText(Sorting::timeToString(getDuration()), textPos);
                     }
                 }
                 if((!displayText.isEmpty()) && (document->getFunction(version) == DocumentFunctionContextual)) {
-                    textPos = QPoint(timelineBoundingRect.center().x() - timelineDocumentText.size.width()/2, timelineBoundingRect.top() - timelineDocumentText.size.height() - 1);
-                    timelineDocumentText.drawText(displayText, textPos, qMax(20., timelineBoundingRect.width()));
+                    TagRender *tagRender = getRender();
+                    textPos = QPoint(timelineBoundingRect.center().x() - tagRender->timelineDocumentText.size.width()/2, timelineBoundingRect.top() - tagRender->timelineDocumentText.size.height() - 1);
+                    tagRender->timelineDocumentText.drawText(displayText, textPos, qMax(20., timelineBoundingRect.width()));
                 }
             }
 
@@ -699,7 +772,7 @@ const QRectF Tag::paintViewer(quint16 tagIndex) {
         //Temps
         else if((decounter < 0) || (!Global::timerPlay)) {
             Global::viewerGL->qglColor(Global::colorText);
-            viewerTimeText.drawText(Sorting::timeToString(getTimeStart()));
+            getRender()->viewerTimeText.drawText(Sorting::timeToString(getTimeStart()));
         }
 
 
@@ -718,7 +791,7 @@ const QRectF Tag::paintViewer(quint16 tagIndex) {
         QString texte = document->getName(version);
         if(getType() == TagTypeContextualTime)
             texte += QString(" (%1)").arg(Sorting::timeToString(getDuration()));
-        viewerDocumentText.drawText(texte, textePos);
+        getRender()->viewerDocumentText.drawText(texte, textePos);
 
         glPopMatrix();
     }
@@ -794,8 +867,8 @@ bool Tag::mouseTimeline(const QPointF &pos, QMouseEvent *e, bool dbl, bool, bool
 
             //Opens
             if(dbl) {
-                if(document->chutierItem)
-                    document->chutierItem->fileShowInOS();
+                if(document->getChutierItem())
+                    document->getChutierItem()->fileShowInOS();
                 else if(document->getType(version) == DocumentTypeWeb)
                     UiFileItem::fileShowInOS(document->getMetadata("Rekall", "URL", version).toString());
                 tagScale     = 3;
@@ -822,12 +895,12 @@ bool Tag::mouseViewer(const QPointF &pos, QMouseEvent *e, bool dbl, bool, bool,
             if(Global::selectedTags.contains(this)) Global::selectedTags.removeOne(this);
             else                                    Global::selectedTags.append(this);
             Global::selectedTagsInAction.clear();
-            if(document->chutierItem)
-                Global::chutier->setCurrentItem(document->chutierItem);
+            if(document->getChutierItem())
+                Global::chutier->setCurrentItem(document->getChutierItem());
         }
-        if((dbl) && (document->chutierItem)) {
+        if((dbl) && (document->getChutierItem())) {
             /*
-            document->chutierItem->fileShowInOS();
+            document->getChutierItem()->fileShowInOS();
             tagScale     = 3;
             tagDestScale = 1;
             */
@@ -911,19 +984,6 @@ bool Tag::sortColor(const Tag *first, const Tag *second) {
     else
         return firstStr < secondStr;
 }
-bool Tag::sortViewer(const Tag *first, const Tag *second) {
-    if((!first) || (!second))
-        return false;
-    if((first->progressionDest == second->progressionDest) || (((0. < first->progressionDest) && (first->progressionDest < 1.)) && ((0. < second->progressionDest) && (second->progressionDest < 1.))))
-        return first->getTimeStart() < second->getTimeStart();
-    else
-        return first->progressionDest > second->progressionDest;
-}
-bool Tag::sortEvents(const Tag *first, const Tag *second) {
-    if((!first) || (!second))
-        return false;
-    return first->getTimeStart() < second->getTimeStart();
-}
 bool Tag::sortAlpha(const Tag *first, const Tag *second) {
     if((!first) || (!second))
         return false;
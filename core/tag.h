@@ -38,11 +38,35 @@ public:
 };
 
 
+class TagRender {
+public:
+    explicit TagRender();
+
+public:
+    GlText    viewerTimeText, viewerDocumentText, timelineTimeStartText, timelineTimeEndText, timelineTimeDurationText, timelineDocumentText;
+    TagRender **owner;
+    quint32    lastFrame;
+
+public:
+    static quint32 frame, framesBeforeRecycle;
+    static QList<TagRender*> used, available;
+    static TagRender* acquire(TagRender **owner);
+    static void release(TagRender *render);
+    static void recycle();
+    static void report(quint32 tagCount);
+};
+
+
 class Tag : public QObject, public Nameable {
     Q_OBJECT
 
 public:
     explicit Tag(DocumentBase *_document, qint16 _documentVersion = -1);
+    ~Tag();
+    static quint32 instances;
+    static ObjectPool pool;
+    static void* operator new   (size_t size)            { return pool.allocate(size); }
+    static void  operator delete(void *tag, size_t size) { pool.release(tag, size);    }
 
 private:
     qreal   timeStart, timeEnd, timeMediaOffset;
@@ -93,6 +117,8 @@ private:
     bool   timelineWasInside, isInProgress;
     qreal  progressionDest, decounter;
     qreal  blinkTime;
+    qreal   timelineHorizontalPos;
+    quint32 timelineHorizontalPosVersion;
     QColor colorDest;
     QColor realTimeColor;
     bool   breathing;
@@ -126,8 +152,14 @@ public:
     bool fireEvents();
 
 private:
-    GlText  viewerTimeText, viewerDocumentText, timelineTimeStartText, timelineTimeEndText, timelineTimeDurationText, timelineDocumentText;
-    GlRect  viewerTimePastille;
+    TagRender *render;
+    inline TagRender* getRender() {
+        if(!render)
+            render = TagRender::acquire(&render);
+        render->lastFrame = TagRender::frame;
+        return render;
+    }
+private:
     bool    timelineFirstPos, timelineFirstPosVisible;
     bool    viewerFirstPos, viewerFirstPosVisible;
     QRectF  timelineBoundingRect, viewerBoundingRect;
@@ -171,8 +203,6 @@ public:
     bool isAcceptableWithHorizontalFilters(bool strongCheck) const;
     const QString getAcceptableWithClusterFilters() const;
     static bool sortColor (const Tag *first, const Tag *second);
-    static bool sortViewer(const Tag *first, const Tag *second);
-    static bool sortEvents(const Tag *first, const Tag *second);
     static bool sortAlpha (const Tag *first, const Tag *second);
     static const QString getCriteriaSort              (const Tag *tag);
     static const QString getCriteriaColor             (const Tag *tag);
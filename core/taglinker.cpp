@@ -0,0 +1,157 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "taglinker.h"
+
+TagLinker::TagLinker(QObject *parent) :
+    QThread(parent) {
+    showHistory = sortByDate = showHashed = false;
+    pending = resultAvailable = false;
+}
+
+void TagLinker::compute(const QList<Document*> &projectDocuments) {
+    //Snapshot of what the links depend on, taken on the GUI thread
+    QList<TagLinkerDocument> snapshot;
+    foreach(Document *document, projectDocuments) {
+        TagLinkerDocument documentSnapshot;
+        documentSnapshot.hash         = document->getMetadata("File", "Hash").toString();
+        documentSnapshot.versionCount = document->getMetadataCount();
+        foreach(Tag *tag, document->tags) {
+            documentSnapshot.tags             << tag;
+            documentSnapshot.tagVersions      << tag->getDocumentVersion();
+            documentSnapshot.tagIsLastVersion << Tag::isTagLastVersion(tag);
+        }
+        snapshot << documentSnapshot;
+    }
+
+    QMutexLocker locker(&mutex);
+    documentsPending = snapshot;
+    showHistory      = Global::showHistory;
+    sortByDate       = Global::tagSortCriteria->isDate();
+    showHashed       = Global::timelineGL->showHashedTagsDest;
+    pending          = true;
+    resultAvailable  = false;
+    if(!isRunning()) {
+        documents = documentsPending;
+        documentsPending.clear();
+        pending = false;
+        start();
+    }
+}
+
+bool TagLinker::publish() {
+    if(isRunning())
+        return false;
+
+    QMutexLocker locker(&mutex);
+    //Sorting changed again while computing : the newest snapshot wins
+    if(pending) {
+        documents = documentsPending;
+        documentsPending.clear();
+        pending = false;
+        start();
+        return false;
+    }
+    if(!resultAvailable)
+        return false;
+
+    foreach(Tag *tag, result.tags) {
+        tag->historyTags = result.historyTags.value(tag);
+        tag->hashTags    = result.hashTags.value(tag);
+    }
+    Global::timeline->setDuplicates(result.nbDuplicates);
+    Global::timeline->setHistories(result.nbHistories);
+    result = TagLinkerResult();
+    resultAvailable = false;
+    return true;
+}
+
+void TagLinker::cancel() {
+    wait();
+    QMutexLocker locker(&mutex);
+    documents.clear();
+    documentsPending.clear();
+    result = TagLinkerResult();
+    pending = resultAvailable = false;
+}
+
+void TagLinker::run() {
+    TagLinkerResult computed;
+    computed.nbDuplicates = computed.nbHistories = 0;
+
+    mutex.lock();
+    bool _showHistory = showHistory, _sortByDate = sortByDate, _showHashed = showHashed;
+    mutex.unlock();
+
+    //Group documents by content hash, in project order
+    QHash<QString, QList<quint32> > documentsByHash;
+    for(quint32 documentIndex = 0 ; documentIndex < (quint32)documents.count() ; documentIndex++) {
+        const TagLinkerDocument &document = documents.at(documentIndex);
+        computed.tags << document.tags;
+        if(!document.hash.isEmpty())
+            documentsByHash[document.hash].append(documentIndex);
+
+        //History links, grouped by version inside the document
+        if(document.versionCount > 1) {
+            computed.nbHistories++;
+            if(_showHistory) {
+                if(_sortByDate) {
+                    QHash<qint16, QList<Tag*> > tagsByVersion;
+                    for(quint16 i = 0 ; i < document.tags.count() ; i++)
+                        tagsByVersion[document.tagVersions.at(i)].append(document.tags.at(i));
+                    for(quint16 i = 0 ; i < document.tags.count() ; i++)
+                        if(document.tagVersions.at(i) > 0)
+                            computed.historyTags.insert(document.tags.at(i), tagsByVersion.value(document.tagVersions.at(i)-1));
+                }
+                else {
+                    for(quint16 i = 0 ; i < document.tags.count() ; i++)
+                        if(document.tagIsLastVersion.at(i))
+                            computed.historyTags.insert(document.tags.at(i), document.tags);
+                }
+            }
+        }
+    }
+
+    //Duplicates : each document links to the tags of the following documents sharing its hash
+    QHashIterator<QString, QList<quint32> > documentsByHashIterator(documentsByHash);
+    while(documentsByHashIterator.hasNext()) {
+        documentsByHashIterator.next();
+        const QList<quint32> &group = documentsByHashIterator.value();
+        computed.nbDuplicates += group.count() * (group.count() - 1) / 2;
+        if(!_showHashed)
+            continue;
+
+        QList<Tag*> followingTags;
+        for(qint32 groupIndex = group.count()-1 ; groupIndex >= 0 ; groupIndex--) {
+            const TagLinkerDocument &document = documents.at(group.at(groupIndex));
+            if(followingTags.count())
+                foreach(Tag *tag, document.tags)
+                    computed.hashTags.insert(tag, followingTags);
+            followingTags = document.tags + followingTags;
+        }
+    }
+
+    QMutexLocker locker(&mutex);
+    result = computed;
+    resultAvailable = true;
+}
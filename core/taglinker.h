@@ -0,0 +1,68 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAGLINKER_H
+#define TAGLINKER_H
+
+#include <QThread>
+#include <QMutex>
+#include "document.h"
+
+class TagLinkerDocument {
+public:
+    QString       hash;
+    quint16       versionCount;
+    QList<Tag*>   tags;
+    QList<qint16> tagVersions;
+    QList<bool>   tagIsLastVersion;
+};
+
+class TagLinkerResult {
+public:
+    QHash<Tag*, QList<Tag*> > historyTags, hashTags;
+    QList<Tag*> tags;
+    quint16     nbDuplicates, nbHistories;
+};
+
+class TagLinker : public QThread {
+    Q_OBJECT
+
+public:
+    explicit TagLinker(QObject *parent = 0);
+
+private:
+    QList<TagLinkerDocument> documents, documentsPending;
+    bool            showHistory, sortByDate, showHashed;
+    bool            pending, resultAvailable;
+    TagLinkerResult result;
+    QMutex          mutex;
+public:
+    void compute(const QList<Document*> &projectDocuments);
+    bool publish();
+    void cancel();
+
+protected:
+    void run();
+};
+
+#endif // TAGLINKER_H
@@ -0,0 +1,256 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tagsorter.h"
+
+TagSorter::TagSorter(QObject *parent) :
+    QThread(parent) {
+    timelinePending   = eventsPending   = viewerPending   = false;
+    timelineAvailable = eventsAvailable = viewerAvailable = false;
+}
+
+void TagSorter::sortTimeline(const QVector<TimelineSortEntry> &entries) {
+    mutex.lock();
+    timelineTagsPending = entries;
+    timelinePending     = true;
+    mutex.unlock();
+    schedule();
+}
+void TagSorter::sortEvents(const QList<Tag*> &tags) {
+    QVector<TagSorterEntry> entries = snapshot(tags);
+    mutex.lock();
+    eventsTagsPending = entries;
+    eventsPending     = true;
+    mutex.unlock();
+    schedule();
+}
+void TagSorter::sortViewer(const QList<Tag*> &tags) {
+    QVector<TagSorterEntry> entries = snapshot(tags);
+    mutex.lock();
+    viewerTagsPending = entries;
+    viewerPending     = true;
+    mutex.unlock();
+    schedule();
+}
+const QVector<TagSorterEntry> TagSorter::snapshot(const QList<Tag*> &tags) {
+    //Sort keys are read on the GUI thread, the worker never touches tags
+    QVector<TagSorterEntry> entries;
+    entries.reserve(tags.count());
+    foreach(Tag *tag, tags) {
+        TagSorterEntry entry;
+        entry.timeStart   = tag->getTimeStart();
+        entry.progression = tag->progressionDest;
+        entry.tag         = tag;
+        entries.append(entry);
+    }
+    return entries;
+}
+
+void TagSorter::schedule() {
+    mutex.lock();
+    bool work = timelinePending || eventsPending || viewerPending;
+    mutex.unlock();
+    if((work) && (!isRunning()))
+        start();
+}
+
+bool TagSorter::publishTimeline(QVector<TimelineSortEntry> &entries, QVector<TimelineSortRange> &categories, QVector<TimelineSortRange> &phases) {
+    schedule();
+    QMutexLocker locker(&mutex);
+    if(!timelineAvailable)
+        return false;
+    entries    = timelineTags;
+    categories = timelineCategories;
+    phases     = timelinePhases;
+    timelineTags.clear();
+    timelineCategories.clear();
+    timelinePhases.clear();
+    timelineAvailable = false;
+    return true;
+}
+bool TagSorter::publishEvents(QList<Tag*> &tags) {
+    schedule();
+    QMutexLocker locker(&mutex);
+    if(!eventsAvailable)
+        return false;
+    tags.clear();
+    foreach(const TagSorterEntry &entry, eventsTags)
+        tags.append(entry.tag);
+    eventsTags.clear();
+    eventsAvailable = false;
+    return true;
+}
+bool TagSorter::publishViewer(QList<Tag*> &tags) {
+    schedule();
+    QMutexLocker locker(&mutex);
+    if(!viewerAvailable)
+        return false;
+    tags.clear();
+    foreach(const TagSorterEntry &entry, viewerTags)
+        tags.append(entry.tag);
+    viewerTags.clear();
+    viewerAvailable = false;
+    return true;
+}
+
+void TagSorter::cancel() {
+    mutex.lock();
+    timelinePending = eventsPending = viewerPending = false;
+    mutex.unlock();
+    wait();
+    QMutexLocker locker(&mutex);
+    timelineTags.clear();
+    timelineTagsPending.clear();
+    timelineCategories.clear();
+    timelinePhases.clear();
+    eventsTags.clear();
+    eventsTagsPending.clear();
+    viewerTags.clear();
+    viewerTagsPending.clear();
+    timelineAvailable = eventsAvailable = viewerAvailable = false;
+}
+
+template <typename T>
+void TagSorter::parallelSort(QVector<T> &entries, bool (*lessThan)(const T &, const T &)) {
+    quint16 rangeCount = qMax(1, QThread::idealThreadCount());
+    if((rangeCount == 1) || (entries.count() < 4096)) {
+        qSort(entries.begin(), entries.end(), lessThan);
+        return;
+    }
+
+    //One slice per core, sorted side by side
+    T *data = entries.data();
+    QVector< TagSorterRange<T> > ranges;
+    for(quint16 index = 0 ; index < rangeCount ; index++) {
+        TagSorterRange<T> range;
+        range.begin    = data + (qint64)entries.count() *  index      / rangeCount;
+        range.end      = data + (qint64)entries.count() * (index + 1) / rangeCount;
+        range.middle   = range.end;
+        range.lessThan = lessThan;
+        ranges.append(range);
+    }
+    QtConcurrent::blockingMap(ranges, &TagSorterRange<T>::sort);
+
+    //Then neighbours are merged two by two, each pass in parallel
+    while(ranges.count() > 1) {
+        QVector< TagSorterRange<T> > merges;
+        for(quint16 index = 0 ; index + 1 < ranges.count() ; index += 2) {
+            TagSorterRange<T> range;
+            range.begin    = ranges.at(index).begin;
+            range.middle   = ranges.at(index + 1).begin;
+            range.end      = ranges.at(index + 1).end;
+            range.lessThan = lessThan;
+            merges.append(range);
+        }
+        QtConcurrent::blockingMap(merges, &TagSorterRange<T>::merge);
+        if(ranges.count() % 2)
+            merges.append(ranges.last());
+        ranges = merges;
+    }
+}
+
+void TagSorter::run() {
+    forever {
+        //Take the newest snapshots, older ones were superseded
+        mutex.lock();
+        bool doTimeline = timelinePending, doEvents = eventsPending, doViewer = viewerPending;
+        QVector<TimelineSortEntry> timeline;
+        QVector<TagSorterEntry>    events, viewer;
+        if(doTimeline)  timeline = timelineTagsPending;
+        if(doEvents)    events   = eventsTagsPending;
+        if(doViewer)    viewer   = viewerTagsPending;
+        timelineTagsPending.clear();
+        eventsTagsPending.clear();
+        viewerTagsPending.clear();
+        timelinePending = eventsPending = viewerPending = false;
+        mutex.unlock();
+        if((!doTimeline) && (!doEvents) && (!doViewer))
+            return;
+
+        //Timeline : one sort, then offsets of categories and phases
+        QVector<TimelineSortRange> categories, phases;
+        if(doTimeline) {
+            parallelSort(timeline, TimelineSortEntry::sort);
+            for(quint32 index = 0 ; index < (quint32)timeline.count() ; index++) {
+                const TimelineSortEntry &entry = timeline.at(index);
+                if((categories.isEmpty()) || (categories.last().phase != entry.phase) || (categories.last().sorting != entry.sorting)) {
+                    if((phases.isEmpty()) || (phases.last().phase != entry.phase)) {
+                        TimelineSortRange phaseRange;
+                        phaseRange.phase = entry.phase;
+                        phaseRange.start = phaseRange.end = categories.count();
+                        phases.append(phaseRange);
+                    }
+                    TimelineSortRange categoryRange;
+                    categoryRange.phase   = entry.phase;
+                    categoryRange.sorting = entry.sorting;
+                    categoryRange.start   = index;
+                    categories.append(categoryRange);
+                    phases.last().end++;
+                }
+                categories.last().end = index + 1;
+            }
+        }
+
+        //Events and viewer
+        if(doEvents)
+            parallelSort(events, TagSorterEntry::sortEvents);
+        if(doViewer)
+            parallelSort(viewer, TagSorterEntry::sortViewer);
+
+        //Swap in
+        QMutexLocker locker(&mutex);
+        if(doTimeline) {
+            timelineTags       = timeline;
+            timelineCategories = categories;
+            timelinePhases     = phases;
+            timelineAvailable  = true;
+        }
+        if(doEvents) {
+            eventsTags      = events;
+            eventsAvailable = true;
+        }
+        if(doViewer) {
+            viewerTags      = viewer;
+            viewerAvailable = true;
+        }
+    }
+}
+
+
+bool TimelineSortEntry::sort(const TimelineSortEntry &first, const TimelineSortEntry &second) {
+    if(first.phase   != second.phase)   return first.phase   < second.phase;
+    if(first.sorting != second.sorting) return first.sorting < second.sorting;
+    if(first.cluster != second.cluster) return first.cluster < second.cluster;
+    if(first.color   != second.color)   return first.color   < second.color;
+    if(first.name    != second.name)    return first.name    < second.name;
+    return first.version < second.version;
+}
+bool TagSorterEntry::sortEvents(const TagSorterEntry &first, const TagSorterEntry &second) {
+    return first.timeStart < second.timeStart;
+}
+bool TagSorterEntry::sortViewer(const TagSorterEntry &first, const TagSorterEntry &second) {
+    if((first.progression == second.progression) || (((0. < first.progression) && (first.progression < 1.)) && ((0. < second.progression) && (second.progression < 1.))))
+        return first.timeStart < second.timeStart;
+    else
+        return first.progression > second.progression;
+}
@@ -0,0 +1,99 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAGSORTER_H
+#define TAGSORTER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QVector>
+#include <QtConcurrentMap>
+#include <algorithm>
+#include "document.h"
+
+class TimelineSortEntry {
+public:
+    QString phase, sorting, cluster, color, name;
+    qint16  version;
+    Tag    *tag;
+public:
+    static bool sort(const TimelineSortEntry &first, const TimelineSortEntry &second);
+};
+
+class TimelineSortRange {
+public:
+    QString phase, sorting;
+    quint32 start, end;
+};
+
+class TagSorterEntry {
+public:
+    qreal timeStart, progression;
+    Tag  *tag;
+public:
+    static bool sortEvents(const TagSorterEntry &first, const TagSorterEntry &second);
+    static bool sortViewer(const TagSorterEntry &first, const TagSorterEntry &second);
+};
+
+template <typename T>
+class TagSorterRange {
+public:
+    T   *begin, *middle, *end;
+    bool (*lessThan)(const T &, const T &);
+public:
+    static void sort (TagSorterRange<T> &range) { qSort(range.begin, range.end, range.lessThan); }
+    static void merge(TagSorterRange<T> &range) { std::inplace_merge(range.begin, range.middle, range.end, range.lessThan); }
+};
+
+class TagSorter : public QThread {
+    Q_OBJECT
+
+public:
+    explicit TagSorter(QObject *parent = 0);
+
+private:
+    QVector<TimelineSortEntry> timelineTags,       timelineTagsPending;
+    QVector<TimelineSortRange> timelineCategories, timelinePhases;
+    QVector<TagSorterEntry>    eventsTags,         eventsTagsPending;
+    QVector<TagSorterEntry>    viewerTags,         viewerTagsPending;
+    bool  timelinePending, eventsPending, viewerPending;
+    bool  timelineAvailable, eventsAvailable, viewerAvailable;
+    QMutex mutex;
+public:
+    void sortTimeline(const QVector<TimelineSortEntry> &entries);
+    void sortEvents  (const QList<Tag*> &tags);
+    void sortViewer  (const QList<Tag*> &tags);
+    bool publishTimeline(QVector<TimelineSortEntry> &entries, QVector<TimelineSortRange> &categories, QVector<TimelineSortRange> &phases);
+    bool publishEvents  (QList<Tag*> &tags);
+    bool publishViewer  (QList<Tag*> &tags);
+    void cancel();
+private:
+    void schedule();
+    static const QVector<TagSorterEntry> snapshot(const QList<Tag*> &tags);
+    template <typename T> static void parallelSort(QVector<T> &entries, bool (*lessThan)(const T &, const T &));
+
+protected:
+    void run();
+};
+
+#endif // TAGSORTER_H
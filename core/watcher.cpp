@@ -25,7 +25,31 @@
 
 Watcher::Watcher(QObject *parent) :
     WatcherBase(parent) {
-    watcher = new QFileSystemWatcher(this);
+    //inotify when available, QFileSystemWatcher otherwise
+    watcher        = 0;
+    watcherInotify = new WatcherInotify(this);
+    if(watcherInotify->isValid()) {
+        connect(watcherInotify, SIGNAL(directoryChanged(QString)), SLOT(queueDirectoryChanged(QString)));
+        connect(watcherInotify, SIGNAL(fileChanged(QString)),      SLOT(queueFileChanged(QString)));
+        connect(watcherInotify, SIGNAL(pathRemoved(QString)),      SLOT(pathRemoved(QString)));
+    }
+    else {
+        delete watcherInotify;
+        watcherInotify = 0;
+        watcher = new QFileSystemWatcher(this);
+        connect(watcher, SIGNAL(directoryChanged(QString)), SLOT(queueDirectoryChanged(QString)));
+        connect(watcher, SIGNAL(fileChanged(QString)),      SLOT(queueFileChanged(QString)));
+    }
+
+    //Bursts of changes are delivered once per path
+    changedEvents = 0;
+    changedTimer.setSingleShot(true);
+    changedTimer.setInterval(300);
+    connect(&changedTimer, SIGNAL(timeout()), SLOT(flushChanges()));
+
+    //Tracked files are verified by content in background
+    hasher = new WatcherHasher(this);
+    connect(hasher, SIGNAL(changed(QString)), SLOT(fileHashChanged(QString)));
 
     trayIconOff = QIcon(":/icons/res_tray_icon_black.png");
     trayIconOn  = QIcon(":/icons/res_tray_icon_color.png");
@@ -67,10 +91,17 @@ void Watcher::trayActivated(QSystemTrayIcon::ActivationReason) {
 
 
 void Watcher::sync(const QString &file, bool inTracker) {
-    if((!watcher->directories().contains(file)) && (!watcher->files().contains(file))) {
-        watcher->addPath(file);
-        if(inTracker)
-            watcherTracking.append(file);
+    if(!watcherPaths.contains(file)) {
+        bool added = true;
+        if(watcherInotify)  added = watcherInotify->addPath(file, inTracker);
+        else                watcher->addPath(file);
+        if(added)
+            watcherPaths.insert(file);
+    }
+    if((inTracker) && (watcherPaths.contains(file))) {
+        QFileInfo fileInfo(file);
+        watcherTracking.insert(file);
+        trackedStats.insert(file, qMakePair(fileInfo.size(), fileInfo.lastModified()));
     }
 
     /*
@@ -83,11 +114,65 @@ void Watcher::sync(const QString &file, bool inTracker) {
     */
 }
 void Watcher::unsync(const QString &file, bool inTracker) {
-    if((watcher->directories().contains(file)) || (watcher->files().contains(file))) {
-        watcher->removePath(file);
-        if(inTracker)
-            watcherTracking.removeOne(file);
+    if(watcherPaths.contains(file)) {
+        if(watcherInotify)  watcherInotify->removePath(file);
+        else                watcher->removePath(file);
+        watcherPaths.remove(file);
+        if(inTracker) {
+            watcherTracking.remove(file);
+            trackedStats.remove(file);
+            hasher->cancel(file);
+        }
+    }
+}
+
+void Watcher::queueDirectoryChanged(QString dir) {
+    //QFileSystemWatcher silently drops deleted paths
+    if((watcher) && (watcherPaths.contains(dir)) && (!watcher->directories().contains(dir)))
+        pathRemoved(dir);
+    changedDirectories.insert(dir);
+    changedEvents++;
+    if(!changedTimer.isActive())
+        changedTimer.start();
+}
+void Watcher::queueFileChanged(QString file) {
+    if((watcher) && (watcherPaths.contains(file)) && (!watcher->files().contains(file)))
+        pathRemoved(file);
+    changedFiles.insert(file);
+    changedEvents++;
+    if(!changedTimer.isActive())
+        changedTimer.start();
+}
+void Watcher::pathRemoved(QString file) {
+    if(!watcherPaths.contains(file))
+        return;
+    bool tracked = watcherTracking.contains(file);
+    watcherPaths   .remove(file);
+    watcherTracking.remove(file);
+    trackedStats   .remove(file);
+    hasher->cancel(file);
+
+    //Replaced by an atomic save: the new file is watched and verified again
+    if(QFileInfo(file).exists()) {
+        sync(file, tracked);
+        trackedStats.remove(file);
+        qDebug("[WATCHER] %s replaced, watching it again", qPrintable(file));
     }
+    else
+        qDebug("[WATCHER] %s removed", qPrintable(file));
+}
+void Watcher::flushChanges() {
+    QSet<QString> directories = changedDirectories, files = changedFiles;
+    if(changedEvents > (quint32)(directories.count() + files.count()))
+        qDebug("[WATCHER] %d change events coalesced into %d directories and %d files", changedEvents, directories.count(), files.count());
+    changedDirectories.clear();
+    changedFiles.clear();
+    changedEvents = 0;
+
+    foreach(const QString &directory, directories)
+        emit(directoryChanged(directory));
+    foreach(const QString &file, files)
+        emit(fileChanged(file));
 }
 
 void Watcher::takeTemporarySnapshot() {
@@ -126,10 +211,22 @@ void Watcher::fileWatcherFileChanged(QString file) {
     if(watcherTracking.contains(file)) {
         Document *document = ((Project*)Global::currentProject)->getDocument(file);
         if(document) {
-            if(document->getMetadata("File", "Hash").toString() != Global::getFileHash(file)) {
-                takeTemporarySnapshot();
-                trayIconToOn(document);
-            }
+            //Size and date first, the content is only hashed when they moved
+            QFileInfo fileInfo(file);
+            QPair<qint64, QDateTime> stats = qMakePair(fileInfo.size(), fileInfo.lastModified());
+            if((trackedStats.contains(file)) && (trackedStats.value(file) == stats))
+                return;
+            trackedStats.insert(file, stats);
+            hasher->verify(file, document->getMetadata("File", "Hash").toString());
+        }
+    }
+}
+void Watcher::fileHashChanged(QString file) {
+    if(watcherTracking.contains(file)) {
+        Document *document = ((Project*)Global::currentProject)->getDocument(file);
+        if(document) {
+            takeTemporarySnapshot();
+            trayIconToOn(document);
         }
     }
 }
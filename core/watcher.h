@@ -27,10 +27,13 @@
 #include <QObject>
 #include <QMainWindow>
 #include <QStringList>
+#include <QSet>
 #include <QSystemTrayIcon>
 #include <QMenu>
 #include <QTimer>
 #include "watcherfeeling.h"
+#include "watcherinotify.h"
+#include "watcherhasher.h"
 #ifdef Q_OS_MAC
 #include <Carbon/Carbon.h>
 #endif
@@ -47,8 +50,24 @@ private:
     QDateTime lastScreenshotTimestamp;
 private:
     WatcherFeeling  *feeling;
-    QStringList      watcherTracking;
+    QSet<QString>    watcherTracking;
     QSystemTrayIcon *trayMenu;
+private:
+    QFileSystemWatcher *watcher;
+    WatcherInotify     *watcherInotify;
+    QSet<QString>       watcherPaths;
+    QSet<QString>       changedDirectories, changedFiles;
+    quint32             changedEvents;
+    QTimer              changedTimer;
+private:
+    WatcherHasher      *hasher;
+    QHash<QString, QPair<qint64, QDateTime> > trackedStats;
+private slots:
+    void fileHashChanged(QString);
+    void queueDirectoryChanged(QString);
+    void queueFileChanged(QString);
+    void pathRemoved(QString);
+    void flushChanges();
 
 public:
     void sync  (const QString &file, bool inTracker = false);
@@ -0,0 +1,90 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "watcherhasher.h"
+#include <QCryptographicHash>
+#include <QFile>
+
+WatcherHasher::WatcherHasher(QObject *parent) :
+    QThread(parent) {
+    stopped = false;
+    start(QThread::LowPriority);
+}
+WatcherHasher::~WatcherHasher() {
+    mutex.lock();
+    stopped = true;
+    jobsCondition.wakeAll();
+    mutex.unlock();
+    wait();
+}
+
+void WatcherHasher::verify(const QString &path, const QString &hash) {
+    //A newer event for the same path supersedes the running or queued one
+    QMutexLocker locker(&mutex);
+    WatcherHasherJob job;
+    job.path       = path;
+    job.hash       = hash;
+    job.generation = ++generations[path];
+    jobs.insert(path, job);
+    if(!queue.contains(path))
+        queue.append(path);
+    jobsCondition.wakeAll();
+}
+void WatcherHasher::cancel(const QString &path) {
+    QMutexLocker locker(&mutex);
+    generations[path]++;
+    jobs.remove(path);
+    queue.removeAll(path);
+}
+bool WatcherHasher::isCurrent(const WatcherHasherJob &job) {
+    QMutexLocker locker(&mutex);
+    return (!stopped) && (generations.value(job.path) == job.generation);
+}
+
+void WatcherHasher::run() {
+    forever {
+        mutex.lock();
+        while((queue.isEmpty()) && (!stopped))
+            jobsCondition.wait(&mutex);
+        if(stopped) {
+            mutex.unlock();
+            return;
+        }
+        WatcherHasherJob job = jobs.take(queue.takeFirst());
+        mutex.unlock();
+
+        QCryptographicHash fileHasher(QCryptographicHash::Sha1);
+        QFile fileToHash(job.path);
+        if(!fileToHash.open(QFile::ReadOnly))
+            continue;
+        bool current = true;
+        while((!fileToHash.atEnd()) && (current)) {
+            fileHasher.addData(fileToHash.read(65536));
+            current = isCurrent(job);
+        }
+        fileToHash.close();
+
+        if((current) && (QString(fileHasher.result().toHex()).toUpper() != job.hash))
+            emit(changed(job.path));
+    }
+}
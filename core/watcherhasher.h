@@ -0,0 +1,66 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WATCHERHASHER_H
+#define WATCHERHASHER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+#include <QHash>
+
+class WatcherHasherJob {
+public:
+    QString path, hash;
+    quint32 generation;
+};
+
+class WatcherHasher : public QThread {
+    Q_OBJECT
+
+public:
+    explicit WatcherHasher(QObject *parent = 0);
+    ~WatcherHasher();
+
+private:
+    QStringList                     queue;
+    QHash<QString, WatcherHasherJob> jobs;
+    QHash<QString, quint32>         generations;
+    bool                            stopped;
+    QMutex                          mutex;
+    QWaitCondition                  jobsCondition;
+public:
+    void verify(const QString &path, const QString &hash);
+    void cancel(const QString &path);
+private:
+    bool isCurrent(const WatcherHasherJob &job);
+
+protected:
+    void run();
+
+signals:
+    void changed(QString);
+};
+
+#endif // WATCHERHASHER_H
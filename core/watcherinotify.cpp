@@ -0,0 +1,158 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "watcherinotify.h"
+#include "core/crawler.h"
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+WatcherInotify::WatcherInotify(QObject *parent) :
+    QObject(parent) {
+    inotify  = -1;
+    notifier = 0;
+#ifdef Q_OS_LINUX
+    inotify = inotify_init();
+    if(inotify >= 0) {
+        fcntl(inotify, F_SETFD, FD_CLOEXEC);
+        fcntl(inotify, F_SETFL, fcntl(inotify, F_GETFL) | O_NONBLOCK);
+        notifier = new QSocketNotifier(inotify, QSocketNotifier::Read, this);
+        connect(notifier, SIGNAL(activated(int)), SLOT(readEvents()));
+    }
+#endif
+}
+WatcherInotify::~WatcherInotify() {
+#ifdef Q_OS_LINUX
+    if(inotify >= 0)
+        close(inotify);
+#endif
+}
+
+bool WatcherInotify::addPath(const QString &path, bool recursive) {
+#ifdef Q_OS_LINUX
+    if(inotify < 0)
+        return false;
+
+    QFileInfo file(path);
+    if(!pathsWatch.contains(path)) {
+        quint32 mask = IN_DELETE_SELF | IN_MOVE_SELF;
+        if(file.isDir())    mask |= IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+        else                mask |= IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE;
+        int watch = inotify_add_watch(inotify, QFile::encodeName(path).constData(), mask);
+        if(watch < 0) {
+            qDebug("[WATCHER] Unable to watch %s", qPrintable(path));
+            return false;
+        }
+        watchesPath.insert(watch, path);
+        pathsWatch .insert(path, watch);
+        if(file.isDir())
+            pathsDirectory.insert(path);
+    }
+    pathsUsage[path]++;
+
+    //Subdirectories from the shared listing, released with their recursive path
+    if((recursive) && (file.isDir()) && (!pathsRecursive.contains(path))) {
+        QStringList subPaths;
+        pathsRecursive.insert(path, subPaths);
+        foreach(const CrawlerEntry &entry, Crawler::listing(QDir(path)))
+            if((entry.isDir) && (!entry.isSymLink) && (addPath(path + "/" + entry.name, true)))
+                subPaths << path + "/" + entry.name;
+        pathsRecursive.insert(path, subPaths);
+    }
+    return true;
+#else
+    Q_UNUSED(path);
+    Q_UNUSED(recursive);
+    return false;
+#endif
+}
+void WatcherInotify::removePath(const QString &path) {
+#ifdef Q_OS_LINUX
+    //Still needed by an explicit or recursive registration
+    if(!pathsUsage.contains(path))
+        return;
+    if(--pathsUsage[path] > 0)
+        return;
+    pathsUsage.remove(path);
+
+    if(pathsWatch.contains(path)) {
+        int watch = pathsWatch.take(path);
+        inotify_rm_watch(inotify, watch);
+        watchesPath.remove(watch);
+    }
+    pathsDirectory.remove(path);
+    foreach(const QString &subPath, pathsRecursive.take(path))
+        removePath(subPath);
+#else
+    Q_UNUSED(path);
+#endif
+}
+
+void WatcherInotify::readEvents() {
+#ifdef Q_OS_LINUX
+    quint64 buffer[2048];
+    forever {
+        ssize_t length = read(inotify, buffer, sizeof(buffer));
+        if(length <= 0)
+            break;
+
+        ssize_t offset = 0;
+        while(offset < length) {
+            const struct inotify_event *event = (const struct inotify_event*)((const char*)buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            QString path = watchesPath.value(event->wd);
+            if(path.isEmpty())
+                continue;
+            //Deleted, replaced by an atomic save or unmounted: the watch is gone
+            if(event->mask & IN_IGNORED) {
+                watchesPath.remove(event->wd);
+                pathsWatch .remove(path);
+                pathsUsage .remove(path);
+                pathsDirectory.remove(path);
+                foreach(const QString &subPath, pathsRecursive.take(path))
+                    removePath(subPath);
+                emit(pathRemoved(path));
+                continue;
+            }
+
+            if(pathsDirectory.contains(path)) {
+                if(event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF))
+                    emit(directoryChanged(path));
+                //New subdirectories of recursive watches are registered too
+                if((event->len) && (event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)) && (pathsRecursive.contains(path))) {
+                    QString subPath = path + "/" + QFile::decodeName(event->name);
+                    Crawler::invalidate(path);
+                    bool registered = pathsRecursive.value(path).contains(subPath);
+                    if(((!registered) || (!pathsUsage.contains(subPath))) && (addPath(subPath, true)) && (!registered))
+                        pathsRecursive[path] << subPath;
+                }
+            }
+            else if(event->mask & (IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF))
+                emit(fileChanged(path));
+        }
+    }
+#endif
+}
@@ -0,0 +1,62 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WATCHERINOTIFY_H
+#define WATCHERINOTIFY_H
+
+#include <QObject>
+#include <QSocketNotifier>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+
+class WatcherInotify : public QObject {
+    Q_OBJECT
+
+public:
+    explicit WatcherInotify(QObject *parent = 0);
+    ~WatcherInotify();
+
+private:
+    int              inotify;
+    QSocketNotifier *notifier;
+    QHash<int, QString> watchesPath;
+    QHash<QString, int> pathsWatch;
+    QHash<QString, quint16>     pathsUsage;       //Explicit and recursive registrations
+    QHash<QString, QStringList> pathsRecursive;   //Subdirectories registered by a recursive path
+    QSet<QString>               pathsDirectory;
+public:
+    inline bool isValid() const { return inotify >= 0; }
+    bool addPath   (const QString &path, bool recursive = false);
+    void removePath(const QString &path);
+
+private slots:
+    void readEvents();
+
+signals:
+    void directoryChanged(QString);
+    void fileChanged(QString);
+    void pathRemoved(QString);
+};
+
+#endif // WATCHERINOTIFY_H
@@ -0,0 +1,192 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "eventstreamcontroller.h"
+#include "interfaces/projectapicontroller.h"
+#include "core/document.h"
+
+#define EVENTSTREAM_BUFFER   256
+#define EVENTSTREAM_PENDING  65536
+#define EVENTSTREAM_HEARTBEAT 15000
+
+QList<EventStreamClient*> EventStreamController::clients;
+QMutex     EventStreamController::clientsMutex;
+QAtomicInt EventStreamController::clientsCount;
+quint64    EventStreamController::eventId         = 0;
+quint64    EventStreamController::sentDeparted    = 0;
+quint64    EventStreamController::droppedDeparted = 0;
+qreal      EventStreamController::playheadTime    = -1;
+bool       EventStreamController::playheadPlaying = false;
+QTime      EventStreamController::playheadTimer;
+
+EventStreamClient::EventStreamClient(QTcpSocket *_socket) :
+    QObject(_socket) {
+    socket = _socket;
+    events.resize(EVENTSTREAM_BUFFER);
+    eventsHead = eventsCount = 0;
+    dropped = 0;
+    droppedTotal = sentTotal = 0;
+    scheduled = false;
+    connect(socket, SIGNAL(bytesWritten(qint64)), SLOT(deliver()));
+    connect(&heartbeat, SIGNAL(timeout()), SLOT(beat()));
+    heartbeat.start(EVENTSTREAM_HEARTBEAT);
+}
+EventStreamClient::~EventStreamClient() {
+    EventStreamController::unsubscribe(this);
+}
+
+bool EventStreamClient::push(const QByteArray &event) {
+    QMutexLocker locker(&mutex);
+    if(eventsCount == EVENTSTREAM_BUFFER) {
+        events[eventsHead].clear();
+        eventsHead = (eventsHead + 1) % EVENTSTREAM_BUFFER;
+        eventsCount--;
+        dropped++;
+        droppedTotal++;
+    }
+    events[(eventsHead + eventsCount) % EVENTSTREAM_BUFFER] = event;
+    eventsCount++;
+
+    //Only one delivery waiting in the queue of the connection thread
+    if(scheduled)
+        return false;
+    scheduled = true;
+    return true;
+}
+void EventStreamClient::addCounters(quint64 *_sentTotal, quint64 *_droppedTotal) {
+    QMutexLocker locker(&mutex);
+    *_sentTotal    += sentTotal;
+    *_droppedTotal += droppedTotal;
+}
+void EventStreamClient::deliver() {
+    QByteArray data;
+    mutex.lock();
+    scheduled = false;
+    if(dropped) {
+        data += "event: dropped\ndata: {\"count\":" + QByteArray::number(dropped) + "}\n\n";
+        dropped = 0;
+    }
+    //What the socket can't take yet stays in the buffer until the next bytesWritten()
+    while((eventsCount) && ((socket->bytesToWrite() + data.size()) < EVENTSTREAM_PENDING)) {
+        data += events.at(eventsHead);
+        events[eventsHead].clear();
+        eventsHead = (eventsHead + 1) % EVENTSTREAM_BUFFER;
+        eventsCount--;
+        sentTotal++;
+    }
+    mutex.unlock();
+
+    if(!data.isEmpty()) {
+        socket->write(data);
+        heartbeat.start();
+    }
+}
+void EventStreamClient::beat() {
+    //Keeps proxies from closing an idle stream
+    if(socket->bytesToWrite() == 0)
+        socket->write(":\n\n");
+}
+
+
+EventStreamController::EventStreamController(QObject *parent) :
+    HttpRequestHandler(parent) {
+}
+
+void EventStreamController::service(HttpRequest &, HttpResponse &response) {
+    //No length and no chunks, the stream ends when one of the peers closes it
+    response.setHeader("Content-Type", "text/event-stream; charset=UTF-8");
+    response.setHeader("Cache-Control", "no-cache");
+    response.setHeader("Connection", "close");
+    response.write("retry: 2000\n\n");
+
+    //The client lives in the thread of the connection and goes away with its socket
+    subscribe(new EventStreamClient(response.detach()));
+}
+
+void EventStreamController::subscribe(EventStreamClient *client) {
+    QMutexLocker locker(&clientsMutex);
+    clients.append(client);
+    clientsCount.fetchAndStoreRelaxed(clients.count());
+}
+void EventStreamController::unsubscribe(EventStreamClient *client) {
+    QMutexLocker locker(&clientsMutex);
+    clients.removeOne(client);
+    clientsCount.fetchAndStoreRelaxed(clients.count());
+    client->addCounters(&sentDeparted, &droppedDeparted);
+}
+
+void EventStreamController::publishPlayhead(qreal time, bool playing) {
+    if(clientsCount.fetchAndAddRelaxed(0) == 0)
+        return;
+
+    //Play / pause right away, positions at most 10 times per second
+    if((playing == playheadPlaying) && ((time == playheadTime) || ((!playheadTimer.isNull()) && (playheadTimer.elapsed() < 100))))
+        return;
+    playheadTime    = time;
+    playheadPlaying = playing;
+    playheadTimer.start();
+    publish("playhead", "{\"time\":" + QByteArray::number(time, 'g', 12) + ",\"playing\":" + (playing?"true":"false") + "}");
+}
+void EventStreamController::publishCue(Tag *tag, bool enter) {
+    if(clientsCount.fetchAndAddRelaxed(0) == 0)
+        return;
+
+    DocumentBase *document = tag->getDocument();
+    qint16 version = tag->getDocumentVersionRaw();
+    QByteArray data = "{\"state\":";
+    data += (enter)?("\"enter\""):("\"leave\"");
+    data += ",\"document\":"  + ProjectApiWriter::escape(document->getName(version));
+    data += ",\"type\":"      + ProjectApiWriter::escape(document->getTypeStr(version));
+    data += ",\"author\":"    + ProjectApiWriter::escape(document->getAuthor(version));
+    data += ",\"timeStart\":" + QByteArray::number(tag->getTimeStart(), 'g', 12);
+    data += ",\"timeEnd\":"   + QByteArray::number(tag->getTimeEnd(),   'g', 12);
+    data += ",\"color\":["    + QByteArray::number(document->baseColor.redF(),  'g', 4) + "," + QByteArray::number(document->baseColor.greenF(), 'g', 4) + ","
+                              + QByteArray::number(document->baseColor.blueF(), 'g', 4) + "," + QByteArray::number(document->baseColor.alphaF(), 'g', 4) + "]}";
+    publish("cue", data);
+}
+void EventStreamController::publishDocuments(quint32 revision, quint32 documents, quint32 tags) {
+    if(clientsCount.fetchAndAddRelaxed(0) == 0)
+        return;
+    publish("documents", "{\"revision\":" + QByteArray::number(revision) + ",\"documents\":" + QByteArray::number(documents) + ",\"tags\":" + QByteArray::number(tags) + "}");
+}
+
+void EventStreamController::publish(const QByteArray &event, const QByteArray &data) {
+    QTime timer;
+    timer.start();
+
+    //One shared message for everybody, pushing it only copies a reference
+    QMutexLocker locker(&clientsMutex);
+    QByteArray message = "id: " + QByteArray::number(++eventId) + "\nevent: " + event + "\ndata: " + data + "\n\n";
+    foreach(EventStreamClient *client, clients)
+        if(client->push(message))
+            QMetaObject::invokeMethod(client, "deliver", Qt::QueuedConnection);
+
+    if((timer.elapsed() > 50) || ((Global::falseProject) && ((eventId % 1000) == 0)))
+        report();
+}
+void EventStreamController::report() {
+    quint64 sent = sentDeparted, dropped = droppedDeparted;
+    foreach(EventStreamClient *client, clients)
+        client->addCounters(&sent, &dropped);
+    qDebug("[EVENTS] event %llu : %d clients, %llu events sent, %llu dropped", eventId, clients.count(), sent, dropped);
+}
@@ -0,0 +1,107 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EVENTSTREAMCONTROLLER_H
+#define EVENTSTREAMCONTROLLER_H
+
+#include <QVector>
+#include <QTimer>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QTime>
+#include "interfaces/http/httprequest.h"
+#include "interfaces/http/httpresponse.h"
+#include "interfaces/http/httprequesthandler.h"
+
+class Tag;
+
+class EventStreamClient : public QObject {
+    Q_OBJECT
+
+public:
+    explicit EventStreamClient(QTcpSocket *_socket);
+    ~EventStreamClient();
+
+private:
+    QTcpSocket *socket;
+    QTimer      heartbeat;
+    QMutex      mutex;
+    QVector<QByteArray> events;     //Ring buffer, the oldest event is dropped when full
+    quint16     eventsHead, eventsCount;
+    quint32     dropped;
+    quint64     droppedTotal, sentTotal;
+    bool        scheduled;
+
+public:
+    bool push(const QByteArray &event);
+    void addCounters(quint64 *_sentTotal, quint64 *_droppedTotal);
+
+public slots:
+    void deliver();
+private slots:
+    void beat();
+};
+
+/**
+  Live stream of server-sent events:
+  <code><pre>
+  GET /events
+  event: playhead       data: {"time":12.5,"playing":true}
+  event: cue            data: {"state":"enter","document":"...","type":"video","author":"...","timeStart":10,"timeEnd":20,"color":[1,0,0,1]}
+  event: documents      data: {"revision":4,"documents":12,"tags":30}
+  event: dropped        data: {"count":3}
+  </pre></code>
+  Publishing never waits for a client: each one has its own bounded buffer that is
+  drained in the thread of its connection. When a client is too slow, its oldest
+  events are dropped and it gets told how many it missed.
+*/
+class EventStreamController : public HttpRequestHandler {
+    Q_OBJECT
+    Q_DISABLE_COPY(EventStreamController);
+
+public:
+    explicit EventStreamController(QObject *parent = 0);
+
+public:
+    void service(HttpRequest& request, HttpResponse& response);
+
+public:
+    static void publishPlayhead(qreal time, bool playing);
+    static void publishCue(Tag *tag, bool enter);
+    static void publishDocuments(quint32 revision, quint32 documents, quint32 tags);
+    static void subscribe  (EventStreamClient *client);
+    static void unsubscribe(EventStreamClient *client);
+private:
+    static void publish(const QByteArray &event, const QByteArray &data);
+    static void report();
+private:
+    static QList<EventStreamClient*> clients;
+    static QMutex     clientsMutex;
+    static QAtomicInt clientsCount;
+    static quint64    eventId, sentDeparted, droppedDeparted;
+    static qreal      playheadTime;
+    static bool       playheadPlaying;
+    static QTime      playheadTimer;
+};
+
+#endif // EVENTSTREAMCONTROLLER_H
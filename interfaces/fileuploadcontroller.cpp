@@ -5,7 +5,54 @@
 
 #include "fileuploadcontroller.h"
 
-FileUploadController::FileUploadController() {}
+qint64 FileUploadSession::received() const {
+    qint64 total = 0;
+    QMapIterator<qint64, qint64> rangesIterator(ranges);
+    while(rangesIterator.hasNext()) {
+        rangesIterator.next();
+        total += rangesIterator.value() - rangesIterator.key();
+    }
+    return total;
+}
+void FileUploadSession::addRange(qint64 start, qint64 end) {
+    //Merge with the overlapping or touching ranges
+    QMap<qint64, qint64>::iterator range = ranges.upperBound(start);
+    if(range != ranges.begin()) {
+        QMap<qint64, qint64>::iterator previous = range - 1;
+        if(previous.value() >= start) {
+            start = previous.key();
+            end   = qMax(end, previous.value());
+            range = ranges.erase(previous);
+        }
+    }
+    while((range != ranges.end()) && (range.key() <= end)) {
+        end   = qMax(end, range.value());
+        range = ranges.erase(range);
+    }
+    ranges.insert(start, end);
+}
+QByteArray FileUploadSession::toJson() const {
+    QByteArray json = "{\"id\":\"" + id.toUtf8() + "\",\"size\":" + QByteArray::number(size) + ",\"received\":" + QByteArray::number(received()) + ",\"ranges\":[";
+    QMapIterator<qint64, qint64> rangesIterator(ranges);
+    bool first = true;
+    while(rangesIterator.hasNext()) {
+        rangesIterator.next();
+        if(!first)
+            json += ",";
+        json += "[" + QByteArray::number(rangesIterator.key()) + "," + QByteArray::number(rangesIterator.value()) + "]";
+        first = false;
+    }
+    json += "],\"complete\":" + QByteArray((finished)?("true"):("false")) + "}";
+    return json;
+}
+
+
+FileUploadController::FileUploadController(QSettings *settings) {
+    //Room left for the request line and the headers of a chunk
+    chunkSize = qMax((qint64)4096, (qint64)settings->value("maxRequestSize", "16000").toInt() - 16384);
+    maxUploadSize = settings->value("maxUploadSize", "2147483648").toLongLong();
+    maxUploadReserved = settings->value("maxUploadReserved", "4294967296").toLongLong();
+}
 
 void FileUploadController::service(HttpRequest& request, HttpResponse& response) {
     if(false) {
@@ -15,17 +62,48 @@ void FileUploadController::service(HttpRequest& request, HttpResponse& response)
             qDebug("\t%s = %s", qPrintable(paramsIterator.key()), qPrintable(paramsIterator.value()));
         }
     }
-    foreach(QTemporaryFile *file, request.getUploadedFiles()) {
-        QString filePath = Global::pathCurrent.absoluteFilePath() + "/Upload/";
+
+    //Resumable uploads
+    QByteArray path = request.getPath();
+    if(path == "/upload/session")       return serviceSession(request, response);
+    else if(path == "/upload/chunk")    return serviceChunk(request, response);
+    else if(path == "/upload/status")   return serviceStatus(request, response);
+
+    //Uploads are stored in the opened project
+    QString uploadPath = HttpRequest::getUploadDirectory();
+    if((request.getUploadedFiles().count()) && (uploadPath.isEmpty()))
+        return writeError(response, 503, "no project");
+
+    quint16 uploaded = 0;
+    QMapIterator<QByteArray,QTemporaryFile*> filesIterator(request.getUploadedFiles());
+    while(filesIterator.hasNext()) {
+        filesIterator.next();
+        QTemporaryFile *file = filesIterator.value();
+        //Only a file name, never a path out of the Upload folder
+        QString name = QFileInfo(QString::fromUtf8(request.getParameter("file1"))).fileName();
+        if((name.isEmpty()) || (name.startsWith("."))) {
+            qWarning("[UPLOAD] rejected file name %s", request.getParameter("file1").constData());
+            continue;
+        }
+        QString filePath = uploadPath;
         QDir().mkpath(filePath);
-        filePath = filePath + request.getParameter("file1");
-        file->copy(filePath);
-        emit(fileUploaded(request.getParameter("gps"), request.getParameter("file1"), filePath));
+
+        //The upload was received in the Upload folder, moving it is enough
+        namesMutex.lock();
+        filePath = uniqueFilePath(filePath, name);
+        file->setAutoRemove(false);
+        if(!file->rename(filePath)) {
+            file->setAutoRemove(true);
+            file->copy(filePath);
+        }
+        namesMutex.unlock();
+        uploaded++;
+        emit(fileUploaded(request.getParameter("gps"), name, filePath, request.getUploadedFileHash(filesIterator.key())));
     }
 
     if(request.getParameter("action") == "show") {
-        if(request.getUploadedFiles().count())  response.write("ok");
-        else                                    response.write("upload failed");
+        if(uploaded)    response.write("ok");
+        else            response.write("upload failed");
     }
     else {
         response.setHeader("Content-Type", "text/html; charset=ISO-8859-1");
@@ -40,3 +118,148 @@ void FileUploadController::service(HttpRequest& request, HttpResponse& response)
     }
 }
 
+void FileUploadController::serviceSession(HttpRequest& request, HttpResponse& response) {
+    QString name = QFileInfo(QString::fromUtf8(request.getParameter("name"))).fileName();
+    bool sizeOk = false;
+    qint64 size = request.getParameter("size").toLongLong(&sizeOk);
+    if((name.isEmpty()) || (name.startsWith(".")) || (!sizeOk) || (size < 0))
+        return writeError(response, 400, "bad request");
+    if(size > maxUploadSize)
+        return writeError(response, 413, "upload too large");
+    QString filePath = HttpRequest::getUploadDirectory();
+    if(filePath.isEmpty())
+        return writeError(response, 503, "no project");
+
+    QSharedPointer<FileUploadSession> session(new FileUploadSession());
+    session->id       = QUuid::createUuid().toString().remove("{").remove("}");
+    session->name     = name;
+    session->gps      = request.getParameter("gps");
+    session->size     = size;
+    session->finished = false;
+    session->lastActivity = QDateTime::currentDateTime();
+    QDir().mkpath(filePath);
+    session->filePath = filePath + name;
+    session->file.setFileName(filePath + ".upload_" + session->id);
+
+    //Forget the uploads abandoned for a day, then reserve the room of this one
+    sessionsMutex.lock();
+    QDateTime expiration = QDateTime::currentDateTime().addDays(-1);
+    qint64 reserved = 0;
+    QMutableHashIterator<QString, QSharedPointer<FileUploadSession> > sessionsIterator(sessions);
+    while(sessionsIterator.hasNext()) {
+        sessionsIterator.next();
+        //Kept alive until the session is unlocked, even when it is removed from the hash
+        QSharedPointer<FileUploadSession> existing = sessionsIterator.value();
+        QMutexLocker sessionLocker(&existing->mutex);
+        if(existing->lastActivity < expiration) {
+            if(!existing->finished)
+                existing->file.remove();
+            sessionsIterator.remove();
+        }
+        else if(!existing->finished)
+            reserved += existing->size;
+    }
+    if(reserved + size > maxUploadReserved) {
+        sessionsMutex.unlock();
+        qWarning("[UPLOAD] %lld bytes already reserved by unfinished uploads, %s refused", reserved, qPrintable(name));
+        return writeError(response, 503, "too many uploads");
+    }
+    sessions.insert(session->id, session);
+    sessionsMutex.unlock();
+
+    //Preallocated hidden file, chunks are written at their offset
+    QMutexLocker sessionLocker(&session->mutex);
+    if((!session->file.open(QFile::ReadWrite)) || (!session->file.resize(size))) {
+        qWarning("[UPLOAD] cannot preallocate %s", qPrintable(session->file.fileName()));
+        session->file.remove();
+        sessionLocker.unlock();
+        sessionsMutex.lock();
+        sessions.remove(session->id);
+        sessionsMutex.unlock();
+        return writeError(response, 500, "cannot create file");
+    }
+    qDebug("[UPLOAD] session %s for %s (%lld bytes)", qPrintable(session->id), qPrintable(name), size);
+    if((size == 0) && (!finishSession(session.data())))
+        return writeError(response, 500, "cannot store file");
+
+    response.setHeader("Content-Type", "application/json");
+    response.write("{\"id\":\"" + session->id.toUtf8() + "\",\"chunkSize\":" + QByteArray::number(chunkSize) + "}", true);
+}
+
+void FileUploadController::serviceChunk(HttpRequest& request, HttpResponse& response) {
+    QSharedPointer<FileUploadSession> session = getSession(request);
+    if(!session)
+        return writeError(response, 404, "unknown upload");
+
+    bool offsetOk = false;
+    qint64 offset = request.getParameter("offset").toLongLong(&offsetOk);
+    QByteArray chunk = request.getBody();
+    if((!offsetOk) || (offset < 0) || (offset + chunk.size() > session->size))
+        return writeError(response, 400, "bad offset");
+
+    //Checksum of the chunk, a damaged chunk is simply sent again
+    QByteArray checksum = request.getHeader("X-Chunk-Sha1");
+    if((!checksum.isEmpty()) && (QCryptographicHash::hash(chunk, QCryptographicHash::Sha1).toHex().toUpper() != checksum.toUpper()))
+        return writeError(response, 400, "checksum mismatch");
+
+    QMutexLocker sessionLocker(&session->mutex);
+    if(!session->finished) {
+        session->lastActivity = QDateTime::currentDateTime();
+        if((!session->file.seek(offset)) || (session->file.write(chunk) != chunk.size())) {
+            qWarning("[UPLOAD] cannot write chunk of %s at %lld", qPrintable(session->name), offset);
+            return writeError(response, 500, "cannot write chunk");
+        }
+        session->addRange(offset, offset + chunk.size());
+        //The session stays open when the file cannot be stored, any chunk sent again retries
+        if((session->received() >= session->size) && (!finishSession(session.data())))
+            return writeError(response, 500, "cannot store file");
+    }
+    response.setHeader("Content-Type", "application/json");
+    response.write(session->toJson(), true);
+}
+
+void FileUploadController::serviceStatus(HttpRequest& request, HttpResponse& response) {
+    QSharedPointer<FileUploadSession> session = getSession(request);
+    if(!session)
+        return writeError(response, 404, "unknown upload");
+    QMutexLocker sessionLocker(&session->mutex);
+    response.setHeader("Content-Type", "application/json");
+    response.write(session->toJson(), true);
+}
+
+QSharedPointer<FileUploadSession> FileUploadController::getSession(HttpRequest& request) {
+    QMutexLocker locker(&sessionsMutex);
+    return sessions.value(request.getParameter("id"));
+}
+
+bool FileUploadController::finishSession(FileUploadSession *session) {
+    //Called with the mutex of the session locked
+    session->file.close();
+    QMutexLocker namesLocker(&namesMutex);
+    session->filePath = uniqueFilePath(QFileInfo(session->filePath).absolutePath() + "/", session->name);
+    if(!session->file.rename(session->filePath)) {
+        qWarning("[UPLOAD] cannot move %s to %s", qPrintable(session->file.fileName()), qPrintable(session->filePath));
+        session->file.open(QFile::ReadWrite);
+        return false;
+    }
+    namesLocker.unlock();
+    session->finished = true;
+    qDebug("[UPLOAD] session %s complete", qPrintable(session->id));
+    emit(fileUploaded(session->gps, session->name, session->filePath, QString()));
+    return true;
+}
+
+const QString FileUploadController::uniqueFilePath(const QString &directory, const QString &name) {
+    //Called with namesMutex locked, existing files are never replaced
+    QFileInfo file(directory + name);
+    QString suffix = (file.suffix().isEmpty())?(QString()):("." + file.suffix());
+    QString baseName = name.left(name.length() - suffix.length());
+    for(quint32 iteration = 1 ; file.exists() ; iteration++)
+        file = QFileInfo(directory + baseName + QString(" (%1)").arg(iteration) + suffix);
+    return file.absoluteFilePath();
+}
+
+void FileUploadController::writeError(HttpResponse& response, int statusCode, const QByteArray &description) {
+    response.setStatus(statusCode, description);
+    response.write(description, true);
+}
@@ -10,20 +10,71 @@
 #include "interfaces/http/httprequest.h"
 #include "interfaces/http/httpresponse.h"
 #include "interfaces/http/httprequesthandler.h"
+#include <QSharedPointer>
 
+/**
+  Upload in progress of the resumable upload API. The file is preallocated
+  and chunks are written at their offset, in any order.
+*/
+class FileUploadSession {
+public:
+    QString id, name, gps, filePath;
+    qint64  size;
+    QFile   file;
+    QMap<qint64, qint64> ranges;
+    QDateTime lastActivity;
+    bool    finished;
+    QMutex  mutex;
+
+public:
+    qint64 received() const;
+    void   addRange(qint64 start, qint64 end);
+    QByteArray toJson() const;
+};
+
+/**
+  Receives files from the devices in the venue. Besides the multipart form, files
+  can be sent in chunks that survive dropped connections:
+  <code><pre>
+  POST /upload/session?name=file.jpg&size=123456&gps=...   creates an upload, returns its id and chunk size
+  PUT  /upload/chunk?id=...&offset=0                       body is the chunk (Content-Type: application/octet-stream),
+                                                           X-Chunk-Sha1 header is its hex SHA-1
+  GET  /upload/status?id=...                               returns the received ranges, to resume
+  </pre></code>
+  Chunks must not be larger than maxRequestSize minus the headers, and files not larger
+  than maxUploadSize. Unfinished uploads reserve at most maxUploadReserved bytes of disk
+  together, further sessions are refused with 503 until some complete or expire after a day.
+  An existing file is never replaced, the upload gets a numbered name.
+  The upload is handed over to Rekall::fileUploaded when all bytes are received.
+*/
 class FileUploadController : public HttpRequestHandler {
     Q_OBJECT
     Q_DISABLE_COPY(FileUploadController);
 public:
 
     /** Constructor */
-    FileUploadController();
+    FileUploadController(QSettings *settings);
 
     /** Generates the response */
     void service(HttpRequest& request, HttpResponse& response);
 
+private:
+    QHash<QString, QSharedPointer<FileUploadSession> > sessions;
+    QMutex sessionsMutex;
+    QMutex namesMutex;
+    qint64 chunkSize, maxUploadSize, maxUploadReserved;
+
+private:
+    void serviceSession(HttpRequest& request, HttpResponse& response);
+    void serviceChunk  (HttpRequest& request, HttpResponse& response);
+    void serviceStatus (HttpRequest& request, HttpResponse& response);
+    bool finishSession (FileUploadSession *session);
+    QSharedPointer<FileUploadSession> getSession(HttpRequest& request);
+    static const QString uniqueFilePath(const QString &directory, const QString &name);
+    void writeError    (HttpResponse& response, int statusCode, const QByteArray &description);
+
 signals:
-    void fileUploaded(const QString &, const QString &, const QString &);
+    void fileUploaded(const QString &, const QString &, const QString &, const QString &);
 };
 
 #endif // FILEUPLOADCONTROLLER_H
@@ -5,80 +5,73 @@
 
 #include "httpconnectionhandler.h"
 #include "httpresponse.h"
+#include "httpconnectionhandlerpool.h"
 #include <QTimer>
 #include <QCoreApplication>
+#include <string.h>
 
-HttpConnectionHandler::HttpConnectionHandler(QSettings* settings, HttpRequestHandler* requestHandler)
-    : QThread()
+HttpConnectionHandler::HttpConnectionHandler(QSettings* settings, HttpRequestHandler* requestHandler, HttpConnectionWorker* worker)
+    : QObject(), output(&socket)
 {
     Q_ASSERT(settings!=0);
     Q_ASSERT(requestHandler!=0);
+    Q_ASSERT(worker!=0);
     this->settings=settings;
     this->requestHandler=requestHandler;
+    this->worker=worker;
     currentRequest=0;
-    busy = false;
-    // execute signals in my own thread
-    moveToThread(this);
-    socket.moveToThread(this);
-    readTimer.moveToThread(this);
+    detached=false;
+    waitingForOutput=false;
+    closeAfterOutput=false;
+    readTimeoutInterval=settings->value("readTimeout",10000).toInt();
+    // Used length tracked here, because resize(0) or clear() would free the storage with Qt4
+    readBuffer.resize(4096);
+    readBufferUsed=0;
+    maxRequestSize=settings->value("maxRequestSize","16000").toInt();
+    maxMultiPartSize=settings->value("maxMultiPartSize","1000000").toInt();
+
+    // execute signals in the thread of the worker
+    moveToThread(worker);
+    socket.moveToThread(worker);
+    readTimer.moveToThread(worker);
+    output.moveToThread(worker);
+    // Bounds what the socket buffers while processing is paused, the client is then held back by TCP
+    socket.setReadBufferSize(65536);
     connect(&socket, SIGNAL(readyRead()), SLOT(read()));
     connect(&socket, SIGNAL(disconnected()), SLOT(disconnected()));
+    connect(&output, SIGNAL(drained()), SLOT(outputDrained()));
+    connect(&output, SIGNAL(progressed()), SLOT(outputProgressed()));
     connect(&readTimer, SIGNAL(timeout()), SLOT(readTimeout()));
     readTimer.setSingleShot(true);
+#ifdef SUPERVERBOSE
     qDebug("HttpConnectionHandler (%p): constructed", this);
-    this->start();
+#endif
 }
 
 
 HttpConnectionHandler::~HttpConnectionHandler() {
     socket.close();
-    quit();
-    wait();
+    delete currentRequest;
+    worker->removeConnection(this);
+#ifdef SUPERVERBOSE
     qDebug("HttpConnectionHandler (%p): destroyed", this);
-}
-
-
-void HttpConnectionHandler::run() {
-    qDebug("HttpConnectionHandler (%p): thread started", this);
-    try {
-        exec();
-    }
-    catch (...) {
-        qCritical("HttpConnectionHandler (%p): an uncatched exception occured in the thread",this);
-    }
-    qDebug("HttpConnectionHandler (%p): thread stopped", this);
+#endif
 }
 
 
 void HttpConnectionHandler::handleConnection(int socketDescriptor) {
+#ifdef SUPERVERBOSE
     qDebug("HttpConnectionHandler (%p): handle new connection", this);
-    busy = true;
-    Q_ASSERT(socket.isOpen()==false); // if not, then the handler is already busy
-
-    //UGLY workaround - we need to clear writebuffer before reusing this socket
-    //https://bugreports.qt-project.org/browse/QTBUG-28914
-    socket.connectToHost("",0);
-    socket.abort();
-
+#endif
+    worker->addConnection(this);
     if (!socket.setSocketDescriptor(socketDescriptor)) {
         qCritical("HttpConnectionHandler (%p): cannot initialize socket: %s", this,qPrintable(socket.errorString()));
+        deleteLater();
         return;
     }
-    // Start timer for read timeout
-    int readTimeout=settings->value("readTimeout",10000).toInt();
-    readTimer.start(readTimeout);
-    // delete previous request
-    delete currentRequest;
-    currentRequest=0;
-}
 
-
-bool HttpConnectionHandler::isBusy() {
-    return busy;
-}
-
-void HttpConnectionHandler::setBusy() {
-    this->busy = true;
+    // Start timer for read timeout
+    readTimer.start(readTimeoutInterval);
 }
 
 
@@ -88,54 +81,115 @@ void HttpConnectionHandler::readTimeout() {
     //Commented out because QWebView cannot handle this.
     //socket.write("HTTP/1.1 408 request timeout\r\nConnection: close\r\n\r\n408 request timeout\r\n");
 
-    socket.disconnectFromHost();
+    if (output.isBusy() || socket.bytesToWrite()>0) {
+        // The client stopped reading, closing gracefully would wait for it forever
+        qWarning("HttpConnectionHandler (%p): client does not read, connection aborted",this);
+        socket.abort();
+    }
+    else {
+        socket.disconnectFromHost();
+    }
     delete currentRequest;
     currentRequest=0;
 }
 
 
 void HttpConnectionHandler::disconnected() {
+#ifdef SUPERVERBOSE
     qDebug("HttpConnectionHandler (%p): disconnected", this);
-    socket.close();
+#endif
     readTimer.stop();
-    busy = false;
+    output.clear();
+    deleteLater();
+}
+
+void HttpConnectionHandler::outputDrained() {
+    if (!waitingForOutput) {
+        return;
+    }
+#ifdef SUPERVERBOSE
+    qDebug("HttpConnectionHandler (%p): output drained, resume",this);
+#endif
+    waitingForOutput=false;
+    if (closeAfterOutput) {
+        // The rest is in the socket buffer, which is flushed before closing
+        socket.disconnectFromHost();
+        return;
+    }
+    readTimer.start(readTimeoutInterval);
+    // The socket does not emit readyRead again for the bytes it buffered meanwhile
+    read();
+}
+
+
+void HttpConnectionHandler::outputProgressed() {
+    if (waitingForOutput) {
+        readTimer.start(readTimeoutInterval);
+    }
 }
 
+
 void HttpConnectionHandler::read() {
 #ifdef SUPERVERBOSE
     qDebug("HttpConnectionHandler (%p): read input",this);
 #endif
 
-    // Create new HttpRequest object if necessary
-    if (!currentRequest) {
-        currentRequest=new HttpRequest(settings);
+    // Leave further requests in the socket until the client has read the previous responses
+    if (waitingForOutput) {
+        return;
+    }
+
+    // Input of a connection that has been taken over by a request handler is ignored
+    if (detached) {
+        socket.readAll();
+        return;
+    }
+
+    // Append the received bytes to the buffer of the connection
+    qint64 available=socket.bytesAvailable();
+    if (readBuffer.size()<readBufferUsed+available) {
+        readBuffer.resize(readBufferUsed+available);
     }
+    qint64 received=socket.read(readBuffer.data()+readBufferUsed,available);
+    readBufferUsed+=qMax(received,(qint64)0);
+    QByteArray buffer=QByteArray::fromRawData(readBuffer.constData(),readBufferUsed);
 
-    // Collect data for the request object
-    while (socket.bytesAvailable() && currentRequest->getStatus()!=HttpRequest::complete && currentRequest->getStatus()!=HttpRequest::abort) {
-        currentRequest->readFromSocket(socket);
+    // Parse and dispatch all complete requests, clients may send several without waiting for the responses
+    int position=0;
+    while (position<readBufferUsed) {
+
+        // Create new HttpRequest object if necessary
+        if (!currentRequest) {
+            currentRequest=new HttpRequest(maxRequestSize,maxMultiPartSize);
+        }
+
+        // Collect data for the request object
+        currentRequest->readFromBuffer(buffer,position);
         if (currentRequest->getStatus()==HttpRequest::waitForBody) {
             // Restart timer for read timeout, otherwise it would
             // expire during large file uploads.
-            int readTimeout=settings->value("readTimeout",10000).toInt();
-            readTimer.start(readTimeout);
+            readTimer.start(readTimeoutInterval);
         }
-    }
 
-    // If the request is aborted, return error message and close the connection
-    if (currentRequest->getStatus()==HttpRequest::abort) {
-        socket.write("HTTP/1.1 413 entity too large\r\nConnection: close\r\n\r\n413 Entity too large\r\n");
-        socket.disconnectFromHost();
-        delete currentRequest;
-        currentRequest=0;
-        return;
-    }
+        // If the request is aborted, return error message and close the connection
+        if (currentRequest->getStatus()==HttpRequest::abort) {
+            socket.write("HTTP/1.1 413 entity too large\r\nConnection: close\r\n\r\n413 Entity too large\r\n");
+            socket.disconnectFromHost();
+            delete currentRequest;
+            currentRequest=0;
+            clearReadBuffer();
+            return;
+        }
 
-    // If the request is complete, let the request mapper dispatch it
-    if (currentRequest->getStatus()==HttpRequest::complete) {
+        // Wait for more data if the request is not complete yet
+        if (currentRequest->getStatus()!=HttpRequest::complete) {
+            break;
+        }
+
+        // The request is complete, let the request mapper dispatch it
         readTimer.stop();
         qDebug("HttpConnectionHandler (%p): received request",this);
-        HttpResponse response(&socket);
+        HttpResponse response(&socket,&output,&responseBuffer);
         try {
             requestHandler->service(*currentRequest, response);
         }
@@ -143,21 +197,59 @@ void HttpConnectionHandler::read() {
             qCritical("HttpConnectionHandler (%p): An uncatched exception occured in the request handler",this);
         }
 
+        // The request handler took the connection over, it writes to the socket from now on
+        if (response.isDetached()) {
+            detached=true;
+            delete currentRequest;
+            currentRequest=0;
+            clearReadBuffer();
+            return;
+        }
+
         // Finalize sending the response if not already done
         if (!response.hasSentLastPart()) {
             response.write(QByteArray(),true);
         }
         // Close the connection after delivering the response, if requested
         if (QString::compare(currentRequest->getHeader("Connection"),"close",Qt::CaseInsensitive)==0) {
-            socket.disconnectFromHost();
-        }
-        else {
-            // Start timer for next request
-            int readTimeout=settings->value("readTimeout",10000).toInt();
-            readTimer.start(readTimeout);
+            if (output.isBusy()) {
+                // A file is still being sent, close when it is done
+                closeAfterOutput=true;
+                waitingForOutput=true;
+                readTimer.start(readTimeoutInterval);
+            }
+            else {
+                socket.disconnectFromHost();
+            }
+            delete currentRequest;
+            currentRequest=0;
+            clearReadBuffer();
+            return;
         }
+        // Start timer for next request
+        readTimer.start(readTimeoutInterval);
         // Prepare for next request
         delete currentRequest;
         currentRequest=0;
+        // Pause until the client has read enough of the response, the timer now watches its progress
+        if (output.isBusy()) {
+            waitingForOutput=true;
+            break;
+        }
+    }
+
+    // Keep only the bytes that have not been parsed yet, at the start of the buffer
+    if (position>0) {
+        readBufferUsed-=position;
+        memmove(readBuffer.data(),readBuffer.constData()+position,readBufferUsed);
     }
+    if (readBufferUsed==0 && readBuffer.size()>65536) {
+        // Give back the memory of a large upload, the common requests fit in a few KB
+        readBuffer.resize(4096);
+    }
+}
+
+
+void HttpConnectionHandler::clearReadBuffer() {
+    readBufferUsed=0;
 }
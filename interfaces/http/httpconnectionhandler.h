@@ -12,12 +12,22 @@
 #include <QThread>
 #include "httprequest.h"
 #include "httprequesthandler.h"
+#include "httpconnectionoutput.h"
+
+class HttpConnectionWorker;
 
 /**
-  The connection handler accepts incoming connections and dispatches incoming requests to to a
-  request mapper. Since HTTP clients can send multiple requests before waiting for the response,
+  The connection handler serves one accepted connection and dispatches incoming requests to
+  a request mapper. Since HTTP clients can send multiple requests before waiting for the response,
   the incoming requests are queued and processed one after the other.
   <p>
+  Handlers do not own a thread. Each one is moved to a HttpConnectionWorker, whose event loop
+  multiplexes all the non-blocking sockets assigned to it, so an idle keep-alive connection
+  only costs a socket and a timer.
+  <p>
+  Responses never block the worker. When the client does not read them fast enough, the
+  handler stops processing further requests of the connection until the output is drained.
+  <p>
   Example for the required configuration settings:
   <code><pre>
   readTimeout=60000
@@ -29,54 +39,77 @@
   @see HttpRequest for description of config settings maxRequestSize and maxMultiPartSize
 */
 
-class HttpConnectionHandler : public QThread {
+class HttpConnectionHandler : public QObject {
     Q_OBJECT
     Q_DISABLE_COPY(HttpConnectionHandler)
 public:
 
     /**
-      Constructor.
+      Constructor. The handler and its socket are moved to the thread of the worker.
       @param settings Configuration settings of the HTTP webserver
       @param requestHandler handler that will process each incomin HTTP request
+      @param worker Worker thread whose event loop serves this connection
     */
-    HttpConnectionHandler(QSettings* settings, HttpRequestHandler* requestHandler);
+    HttpConnectionHandler(QSettings* settings, HttpRequestHandler* requestHandler, HttpConnectionWorker* worker);
 
     /** Destructor */
     virtual ~HttpConnectionHandler();
 
-    /** Returns true, if this handler is in use. */
-    bool isBusy();
-
-    /** Mark this handler as busy */
-    void setBusy();
-
 private:
 
     /** Configuration settings */
     QSettings* settings;
 
-    /** TCP socket of the current connection */
+    /** TCP socket of the connection */
     QTcpSocket socket;
 
+    /** Output of the connection, the responses are written through it */
+    HttpConnectionOutput output;
+
+    /** Indicator whether processing of requests is paused until the output is drained */
+    bool waitingForOutput;
+
+    /** Indicator whether the connection is closed when the output is drained */
+    bool closeAfterOutput;
+
     /** Time for read timeout detection */
     QTimer readTimer;
 
     /** Storage for the current incoming HTTP request */
     HttpRequest* currentRequest;
 
+    /** Indicator whether a request handler has taken the connection over */
+    bool detached;
+
+    /** Bytes received from the socket that have not been parsed yet, the storage is kept between reads */
+    QByteArray readBuffer;
+    /** Number of bytes used in the read buffer */
+    int readBufferUsed;
+    /** Forget the received bytes, without freeing the buffer */
+    void clearReadBuffer();
+
+    /** Buffer for the headers of the responses, reused for each request of the connection */
+    QByteArray responseBuffer;
+
+    /** Maximum time to wait for a complete HTTP request (in ms), read once from the settings */
+    int readTimeoutInterval;
+
+    /** Maximum size of requests in bytes, read once from the settings */
+    int maxRequestSize;
+
+    /** Maximum allowed size of multipart forms in bytes, read once from the settings */
+    int maxMultiPartSize;
+
     /** Dispatches received requests to services */
     HttpRequestHandler* requestHandler;
 
-    /** This shows the busy-state from a very early time */
-    bool busy;
-
-    /** Executes the htreads own event loop */
-    void run();
+    /** Worker thread that serves this connection */
+    HttpConnectionWorker* worker;
 
 public slots:
 
     /**
-      Received from from the listener, when the handler shall start processing a new connection.
+      Invoked by the pool in the thread of the worker, when the handler shall start processing a new connection.
       @param socketDescriptor references the accepted connection.
     */
     void handleConnection(int socketDescriptor);
@@ -92,6 +125,11 @@ private slots:
     /** Received from the socket when a connection has been closed */
     void disconnected();
 
+    /** Received from the output when queued responses have been sent, resumes processing requests */
+    void outputDrained();
+
+    /** Received from the output when bytes have been sent, restarts the read timeout */
+    void outputProgressed();
 };
 
 #endif // HTTPCONNECTIONHANDLER_H
@@ -1,4 +1,53 @@
 #include "httpconnectionhandlerpool.h"
+#if QT_VERSION < 0x050000 && !defined(Q_OS_WIN)
+#include <sys/select.h>
+#include <unistd.h>
+#endif
+
+HttpConnectionWorker::HttpConnectionWorker()
+    : QThread()
+{
+    this->start();
+}
+
+HttpConnectionWorker::~HttpConnectionWorker() {
+    quit();
+    wait();
+    qDebug("HttpConnectionWorker (%p): destroyed", this);
+}
+
+void HttpConnectionWorker::run() {
+    qDebug("HttpConnectionWorker (%p): thread started", this);
+    try {
+        exec();
+    }
+    catch (...) {
+        qCritical("HttpConnectionWorker (%p): an uncatched exception occured in the thread",this);
+    }
+    // close the remaining connections while still in this thread
+    QList<HttpConnectionHandler*> remaining=connections.toList();
+    connections.clear();
+    foreach(HttpConnectionHandler* handler, remaining) {
+        delete handler;
+    }
+    qDebug("HttpConnectionWorker (%p): thread stopped", this);
+}
+
+int HttpConnectionWorker::getConnectionCount() {
+    return connectionCount.fetchAndAddRelaxed(0);
+}
+
+void HttpConnectionWorker::addConnection(HttpConnectionHandler* handler) {
+    connections.insert(handler);
+}
+
+void HttpConnectionWorker::removeConnection(HttpConnectionHandler* handler) {
+    if (connections.remove(handler)) {
+        connectionCount.deref();
+    }
+}
+
+
 
 HttpConnectionHandlerPool::HttpConnectionHandlerPool(QSettings* settings, HttpRequestHandler* requestHandler)
     : QObject()
@@ -6,59 +55,69 @@ HttpConnectionHandlerPool::HttpConnectionHandlerPool(QSettings* settings, HttpRe
     Q_ASSERT(settings!=0);
     this->settings=settings;
     this->requestHandler=requestHandler;
-    cleanupTimer.start(settings->value("cleanupInterval",1000).toInt());
-    connect(&cleanupTimer, SIGNAL(timeout()), SLOT(cleanup()));
+    connectionPeak=0;
+    maxConnections=settings->value("maxConnections",1000).toInt();
+#if QT_VERSION < 0x050000 && !defined(Q_OS_WIN)
+    // keep some descriptors for the files and sockets of the application
+    if (maxConnections>FD_SETSIZE-64) {
+        maxConnections=FD_SETSIZE-64;
+        qWarning("HttpConnectionHandlerPool (%p): maxConnections reduced to %i by FD_SETSIZE", this, maxConnections);
+    }
+#endif
+    int workerThreads=settings->value("workerThreads",0).toInt();
+    if (workerThreads<=0) {
+        workerThreads=qMax(1,QThread::idealThreadCount());
+    }
+    for (int i=0; i<workerThreads; i++) {
+        workers.append(new HttpConnectionWorker());
+    }
+    qDebug("HttpConnectionHandlerPool (%p): started %i workers", this, workers.count());
 }
 
 
 HttpConnectionHandlerPool::~HttpConnectionHandlerPool() {
-    // delete all connection handlers and wait until their threads are closed
-    foreach(HttpConnectionHandler* handler, pool) {
-        delete handler;
+    // stop all workers, they close their connections before their threads end
+    foreach(HttpConnectionWorker* worker, workers) {
+        delete worker;
     }
     qDebug("HttpConnectionHandlerPool (%p): destroyed", this);
 }
 
 
-HttpConnectionHandler* HttpConnectionHandlerPool::getConnectionHandler() {   
-    HttpConnectionHandler* freeHandler=0;
-    mutex.lock();
-    // find a free handler in pool
-    foreach(HttpConnectionHandler* handler, pool) {
-        if (!handler->isBusy()) {
-            freeHandler=handler;
-            freeHandler->setBusy();
-            break;
-        }
+bool HttpConnectionHandlerPool::handleConnection(int socketDescriptor) {
+#if QT_VERSION < 0x050000 && !defined(Q_OS_WIN)
+    // select() cannot watch higher descriptors, not even to send the rejection
+    if (socketDescriptor>=FD_SETSIZE) {
+        qWarning("HttpConnectionHandlerPool (%p): descriptor %i above FD_SETSIZE, connection closed", this, socketDescriptor);
+        ::close(socketDescriptor);
+        return true;
     }
-    // create a new handler, if necessary
-    if (!freeHandler) {
-        int maxConnectionHandlers=settings->value("maxThreads",100).toInt();
-        if (pool.count()<maxConnectionHandlers) {
-            freeHandler=new HttpConnectionHandler(settings,requestHandler);
-            freeHandler->setBusy();
-            pool.append(freeHandler);
+#endif
+    // find the least loaded worker
+    HttpConnectionWorker* freeWorker=0;
+    int freeCount=0, totalCount=0;
+    foreach(HttpConnectionWorker* worker, workers) {
+        int count=worker->getConnectionCount();
+        totalCount+=count;
+        if (!freeWorker || count<freeCount) {
+            freeWorker=worker;
+            freeCount=count;
         }
     }
-    mutex.unlock();
-    return freeHandler;
-}
-
-
-
-void HttpConnectionHandlerPool::cleanup() {
-    int maxIdleHandlers=settings->value("minThreads",1).toInt();
-    int idleCounter=0;
-    mutex.lock();
-    foreach(HttpConnectionHandler* handler, pool) {
-        if (!handler->isBusy()) {
-            if (++idleCounter > maxIdleHandlers) {
-                pool.removeOne(handler);                
-                delete handler;
-                qDebug("HttpConnectionHandlerPool: Removed connection handler (%p), pool size is now %i",handler,pool.size());
-                break; // remove only one handler in each interval
-            }
+    if (totalCount>=maxConnections) {
+        return false;
+    }
+    if (++totalCount>connectionPeak) {
+        connectionPeak=totalCount;
+        if (connectionPeak%100==0) {
+            qDebug("HttpConnectionHandlerPool (%p): %i concurrent connections on %i workers", this, connectionPeak, workers.count());
         }
     }
-    mutex.unlock();
+    freeWorker->connectionCount.ref();
+
+    // The descriptor is passed with a queued call because the handler lives in the worker
+    // thread and cannot open the socket when called by another thread.
+    HttpConnectionHandler* handler=new HttpConnectionHandler(settings,requestHandler,freeWorker);
+    QMetaObject::invokeMethod(handler, "handleConnection", Qt::QueuedConnection, Q_ARG(int, socketDescriptor));
+    return true;
 }
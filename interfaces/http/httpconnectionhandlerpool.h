@@ -2,27 +2,68 @@
 #define HTTPCONNECTIONHANDLERPOOL_H
 
 #include <QList>
-#include <QTimer>
+#include <QSet>
 #include <QObject>
-#include <QMutex>
+#include <QThread>
+#include <QAtomicInt>
 #include "httpconnectionhandler.h"
 
 /**
-  Pool of http connection handlers. Connection handlers are created on demand and idle handlers are
-  cleaned up in regular time intervals.
+  Worker thread of the connection handler pool. Its event loop serves all the connections
+  that were assigned to it, each one being a HttpConnectionHandler living in this thread.
+*/
+
+class HttpConnectionWorker : public QThread {
+    Q_OBJECT
+    Q_DISABLE_COPY(HttpConnectionWorker)
+public:
+
+    /** Constructor, starts the thread. */
+    HttpConnectionWorker();
+
+    /** Destructor, stops the thread and closes the connections that are still open. */
+    virtual ~HttpConnectionWorker();
+
+    /** Returns the number of connections served by this worker. Thread-safe. */
+    int getConnectionCount();
+
+    /** Registers a connection. Must be called in the thread of the worker. */
+    void addConnection(HttpConnectionHandler* handler);
+
+    /** Unregisters a connection. Must be called in the thread of the worker. */
+    void removeConnection(HttpConnectionHandler* handler);
+
+private:
+
+    /** Connections served by this worker, only accessed in its own thread */
+    QSet<HttpConnectionHandler*> connections;
+
+    /** Number of connections assigned to this worker by the pool, including the ones not started yet */
+    QAtomicInt connectionCount;
+
+    /** Executes the threads own event loop */
+    void run();
+
+    friend class HttpConnectionHandlerPool;
+};
+
+
+/**
+  Pool of http connection handlers. A fixed number of worker threads is started with the pool,
+  and each accepted connection is assigned to the least loaded one. Workers multiplex their
+  connections on their event loop, so the number of concurrent keep-alive connections is not
+  bound to the number of threads.
   <p>
   Example for the required configuration settings:
   <code><pre>
-  minThreads=1
-  maxThreads=100
-  cleanupInterval=1000
+  workerThreads=0
+  maxConnections=1000
   maxRequestSize=16000
   maxMultiPartSize=1000000
   </pre></code>
-  The pool is empty initially and grows with the number of concurrent
-  connections. A timer removes one idle connection handler at each
-  interval, but it leaves some spare handlers in memory to improve
-  performance.
+  The number of workers defaults to the number of processor cores when workerThreads is 0.
+  Connections beyond maxConnections are rejected. With Qt4 the event dispatcher is based
+  on select(), so the limit is kept below FD_SETSIZE and higher descriptors are closed.
   @see HttpConnectionHandler for description of config settings readTimeout
   @see HttpRequest for description of config settings maxRequestSize and maxMultiPartSize
 */
@@ -43,8 +84,13 @@ public:
     /** Destructor */
     virtual ~HttpConnectionHandlerPool();
 
-    /** Get a free connection handler, or 0 if not available. */
-    HttpConnectionHandler* getConnectionHandler();
+    /**
+      Assigns a new incoming connection to the least loaded worker.
+      Must be called in the thread of the pool.
+      @param socketDescriptor references the accepted connection.
+      @return false if there are too many connections, the caller must reject it then.
+    */
+    bool handleConnection(int socketDescriptor);
 
 private:
 
@@ -54,19 +100,13 @@ private:
     /** Will be assigned to each Connectionhandler during their creation */
     HttpRequestHandler* requestHandler;
 
-    /** Pool of connection handlers */
-    QList<HttpConnectionHandler*> pool;
-
-    /** Timer to clean-up unused connection handler */
-    QTimer cleanupTimer;
-
-    /** Used to synchronize threads */
-    QMutex mutex;
-
-private slots:
+    /** Fixed set of worker threads */
+    QList<HttpConnectionWorker*> workers;
 
-    /** Received from the clean-up timer.  */
-    void cleanup();
+    /** Highest number of concurrent connections seen, for load reports */
+    int connectionPeak;
+    /** Maximum number of concurrent connections */
+    int maxConnections;
 
 };
 
@@ -0,0 +1,236 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "httpconnectionoutput.h"
+#include <string.h>
+#ifdef Q_OS_UNIX
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/sendfile.h>
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+HttpConnectionOutput::HttpConnectionOutput(QTcpSocket* socket)
+    : QObject()
+{
+    Q_ASSERT(socket!=0);
+    this->socket=socket;
+    writeNotifier=0;
+    connect(socket, SIGNAL(bytesWritten(qint64)), SLOT(socketBytesWritten(qint64)));
+}
+
+bool HttpConnectionOutput::write(const QByteArray& head, const QByteArray& body, const QByteArray& tail) {
+    if (!socket->isOpen()) {
+        return false;
+    }
+    if (!segments.isEmpty()) {
+        // A file is still being sent, the parts follow it. Concatenating copies them,
+        // because they may only be views on buffers of the caller.
+        Segment segment;
+        segment.data=head+body+tail;
+        segment.offset=0;
+        segment.remaining=0;
+        segment.copy=false;
+        segments.append(segment);
+        return true;
+    }
+    const QByteArray* parts[3]={&head,&body,&tail};
+    int part=0;
+    qint64 offset=0;
+#ifdef Q_OS_UNIX
+    // Nothing queued in the socket, so the kernel can take all parts at once
+    if (socket->bytesToWrite()==0) {
+        iovec vector[3];
+        int count=0;
+        for (int i=0; i<3; i++) {
+            if (parts[i]->size()>0) {
+                vector[count].iov_base=(void*)parts[i]->constData();
+                vector[count].iov_len=parts[i]->size();
+                count++;
+            }
+        }
+        // sendmsg() instead of writev(), so a client that reset the connection does not raise SIGPIPE
+        msghdr message;
+        memset(&message,0,sizeof(message));
+        message.msg_iov=vector;
+        message.msg_iovlen=count;
+        ssize_t written=0;
+        do {
+            written=::sendmsg(socket->socketDescriptor(),&message,MSG_NOSIGNAL);
+        } while (written<0 && errno==EINTR);
+        if (written<0) {
+            // The TCP buffer is full (EAGAIN) or the socket failed, let the socket deal with it
+            written=0;
+        }
+        while (part<3 && written>=parts[part]->size()) {
+            written-=parts[part]->size();
+            part++;
+        }
+        offset=written;
+    }
+#endif
+    // Queue the rest, the event loop of the worker writes it out
+    for (; part<3; part++) {
+        if (offset<parts[part]->size()) {
+            if (socket->write(parts[part]->constData()+offset,parts[part]->size()-offset)==-1) {
+                return false;
+            }
+        }
+        offset=0;
+    }
+    return true;
+}
+
+bool HttpConnectionOutput::writeFile(const QFile& file, qint64 offset, qint64 length) {
+    if (!socket->isOpen()) {
+        return false;
+    }
+    if (length<=0) {
+        return true;
+    }
+    Segment segment;
+    segment.file=QSharedPointer<QFile>(new QFile(file.fileName()));
+    if (!segment.file->open(QIODevice::ReadOnly)) {
+        qWarning("HttpConnectionOutput: cannot open file %s",qPrintable(file.fileName()));
+        return false;
+    }
+    segment.offset=offset;
+    segment.remaining=length;
+#ifdef Q_OS_LINUX
+    segment.copy=false;
+#else
+    segment.copy=true;
+#endif
+    segments.append(segment);
+    pump();
+    return socket->isOpen();
+}
+
+bool HttpConnectionOutput::isBusy() const {
+    return !segments.isEmpty() || socket->bytesToWrite()>maxPendingBytes;
+}
+
+void HttpConnectionOutput::clear() {
+    segments.clear();
+    if (writeNotifier) {
+        writeNotifier->setEnabled(false);
+    }
+}
+
+bool HttpConnectionOutput::pump() {
+    while (!segments.isEmpty()) {
+        if (!socket->isOpen()) {
+            clear();
+            return false;
+        }
+        Segment& segment=segments.first();
+        if (segment.file.isNull()) {
+            if (socket->write(segment.data)==-1) {
+                clear();
+                return false;
+            }
+        }
+        else if (!pumpFile(segment)) {
+            return false;
+        }
+        segments.removeFirst();
+    }
+    return true;
+}
+
+bool HttpConnectionOutput::pumpFile(Segment& segment) {
+#ifdef Q_OS_LINUX
+    if (!segment.copy) {
+        // The kernel writes the file behind the data queued in the socket, so that must be sent first
+        if (socket->bytesToWrite()>0) {
+            return false;
+        }
+        int socketDescriptor=socket->socketDescriptor();
+        while (segment.remaining>0) {
+            off_t filePosition=segment.offset;
+            ssize_t sent=::sendfile(socketDescriptor,segment.file->handle(),&filePosition,(size_t)qMin(segment.remaining,(qint64)0x40000000));
+            if (sent>0) {
+                segment.offset+=sent;
+                segment.remaining-=sent;
+            }
+            else if (sent<0 && errno==EINTR) {
+                continue;
+            }
+            else if (sent<0 && errno==EAGAIN) {
+                // The TCP buffer is full. The socket itself has nothing queued, so its own
+                // write notifier is disabled and this one can watch the descriptor.
+                if (!writeNotifier) {
+                    writeNotifier=new QSocketNotifier(socketDescriptor,QSocketNotifier::Write,this);
+                    connect(writeNotifier, SIGNAL(activated(int)), SLOT(socketWritable()));
+                }
+                writeNotifier->setEnabled(true);
+                return false;
+            }
+            else if (sent<0 && (errno==EINVAL || errno==ENOSYS)) {
+                // Not supported for this file, copy it through the socket instead
+                segment.copy=true;
+                break;
+            }
+            else {
+                qWarning("HttpConnectionOutput: cannot send file %s, connection aborted",qPrintable(segment.file->fileName()));
+                socket->abort();
+                clear();
+                return false;
+            }
+        }
+    }
+#endif
+    // Copy the file through the socket buffer window by window, bytesWritten asks for the next one
+    while (segment.remaining>0) {
+        if (socket->bytesToWrite()>=maxPendingBytes) {
+            return false;
+        }
+        qint64 chunk=qMin(segment.remaining,(qint64)maxPendingBytes);
+        qint64 written=-1;
+        uchar* mapped=segment.file->map(segment.offset,chunk);
+        if (mapped) {
+            written=socket->write((const char*)mapped,chunk);
+            segment.file->unmap(mapped);
+        }
+        else {
+            segment.file->seek(segment.offset);
+            QByteArray buffer=segment.file->read(chunk);
+            if (!buffer.isEmpty()) {
+                written=socket->write(buffer);
+            }
+        }
+        if (written<=0) {
+            qWarning("HttpConnectionOutput: cannot send file %s at position %lli, connection aborted",qPrintable(segment.file->fileName()),segment.offset);
+            socket->abort();
+            clear();
+            return false;
+        }
+        segment.offset+=written;
+        segment.remaining-=written;
+    }
+    return true;
+}
+
+void HttpConnectionOutput::resume() {
+    pump();
+    emit progressed();
+    if (!isBusy()) {
+        emit drained();
+    }
+}
+
+void HttpConnectionOutput::socketBytesWritten(qint64) {
+    resume();
+}
+
+void HttpConnectionOutput::socketWritable() {
+    writeNotifier->setEnabled(false);
+    resume();
+}
@@ -0,0 +1,125 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef HTTPCONNECTIONOUTPUT_H
+#define HTTPCONNECTIONOUTPUT_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QFile>
+#include <QList>
+#include <QSharedPointer>
+#include <QSocketNotifier>
+
+/**
+  Output side of a connection. Responses are written through it without ever blocking the
+  worker thread: what the kernel does not take at once is queued in the socket and written
+  by the event loop of the worker.
+  <p>
+  The connection handler must not start the next request while the output is busy, so that
+  a client which does not read its responses cannot make the queue grow without limit.
+  It waits for the drained() signal instead.
+  <p>
+  Parts of files are queued as well and sent from the event loop, on Linux with sendfile()
+  whenever the socket becomes writable, so a large download never holds the worker. Data
+  written behind a file waits in the queue until the file has been sent.
+*/
+
+class HttpConnectionOutput : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY(HttpConnectionOutput)
+public:
+
+    /**
+      Constructor.
+      @param socket Socket of the connection, it must live in the same thread as this object
+    */
+    HttpConnectionOutput(QTcpSocket* socket);
+
+    /**
+      Write raw data to the socket. When nothing is queued in the socket, all parts are passed
+      to the kernel with a single sendmsg() without copying them together. What the kernel does
+      not take is queued in the socket.
+      @param head First part, usually the headers or the chunk size
+      @param body Second part, usually the body data
+      @param tail Third part, usually the end of the chunk
+      @return false if the socket is closed or failed
+    */
+    bool write(const QByteArray& head, const QByteArray& body=QByteArray(), const QByteArray& tail=QByteArray());
+
+    /**
+      Queue a part of a file. The file is opened again by its name, so the caller may close
+      its own file immediately.
+      @param file File to send
+      @param offset Position of the first byte to send
+      @param length Number of bytes to send
+      @return false if the socket is closed or the file cannot be opened
+    */
+    bool writeFile(const QFile& file, qint64 offset, qint64 length);
+
+    /** Indicates whether a file is being sent or more than maxPendingBytes wait to be sent */
+    bool isBusy() const;
+
+    /** Drop everything that has not been sent yet, called when the connection is closed */
+    void clear();
+
+signals:
+
+    /** Emitted by the event loop when bytes have been sent, so that the connection is not idle */
+    void progressed();
+
+    /** Emitted by the event loop when the output is not busy anymore */
+    void drained();
+
+private:
+
+    /** Socket of the connection */
+    QTcpSocket* socket;
+
+    /** Amount of queued bytes above which the output is busy */
+    static const int maxPendingBytes=262144;
+
+    /** Queued part of the output, either data or a part of a file */
+    struct Segment {
+        /** Data to send, when this is not a file */
+        QByteArray data;
+        /** File to send from */
+        QSharedPointer<QFile> file;
+        /** Position of the next byte of the file */
+        qint64 offset;
+        /** Number of bytes of the file that are still to send */
+        qint64 remaining;
+        /** Indicator whether the file is copied through the socket, because sendfile() does not support it */
+        bool copy;
+    };
+
+    /** Parts of the output that wait for a file in front of them */
+    QList<Segment> segments;
+
+    /** Notifies when the TCP buffer has room again after sendfile() filled it, created when needed */
+    QSocketNotifier* writeNotifier;
+
+    /**
+      Send as much of the queued segments as the socket takes without blocking.
+      @return false when the output must wait for the socket
+    */
+    bool pump();
+
+    /** Send as much of a file segment as possible, see pump() */
+    bool pumpFile(Segment& segment);
+
+    /** Continue sending and tell the connection about the progress */
+    void resume();
+
+private slots:
+
+    /** Received from the socket when queued bytes have been written */
+    void socketBytesWritten(qint64 bytes);
+
+    /** Received from the notifier when the TCP buffer has room again */
+    void socketWritable();
+};
+
+#endif // HTTPCONNECTIONOUTPUT_H
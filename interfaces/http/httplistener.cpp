@@ -7,11 +7,19 @@
 #include "httpconnectionhandler.h"
 #include "httpconnectionhandlerpool.h"
 #include <QCoreApplication>
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#endif
 
 HttpListener::HttpListener(QSettings* settings, HttpRequestHandler* requestHandler, QObject *parent)
     : QTcpServer(parent)
 {
     Q_ASSERT(settings!=0);
+#ifdef Q_OS_UNIX
+    // Responses are written to the descriptors directly (sendmsg, sendfile), a client that
+    // resets its connection must not kill the application with SIGPIPE
+    ::signal(SIGPIPE,SIG_IGN);
+#endif
     // Create connection handler pool
     this->settings=settings;
     pool=new HttpConnectionHandlerPool(settings,requestHandler);
@@ -38,17 +46,8 @@ void HttpListener::incomingConnection(int socketDescriptor) {
 #ifdef SUPERVERBOSE
     qDebug("HttpListener: New connection");
 #endif
-    HttpConnectionHandler* freeHandler=pool->getConnectionHandler();
-
-    // Let the handler process the new connection.
-    if (freeHandler) {
-        // The descriptor is passed via signal/slot because the handler lives in another
-        // thread and cannot open the socket when called by another thread.
-        connect(this,SIGNAL(handleConnection(int)),freeHandler,SLOT(handleConnection(int)));
-        emit handleConnection(socketDescriptor);
-        disconnect(this,SIGNAL(handleConnection(int)),freeHandler,SLOT(handleConnection(int)));
-    }
-    else {
+    // Let the least loaded worker process the new connection.
+    if (!pool->handleConnection(socketDescriptor)) {
         // Reject the connection
         qDebug("HttpListener: Too many incoming connections");
         QTcpSocket* socket=new QTcpSocket(this);
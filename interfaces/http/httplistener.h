@@ -20,15 +20,13 @@
   Example for the required settings in the config file:
   <code><pre>
   port=8080
-  minThreads=1
-  maxThreads=10
-  cleanupInterval=1000
+  workerThreads=0
   readTimeout=60000
   maxRequestSize=16000
   maxMultiPartSize=1000000
   </pre></code>
   The port number is the incoming TCP port that this listener listens to.
-  @see HttpConnectionHandlerPool for description of config settings minThreads, maxThreads and cleanupInterval
+  @see HttpConnectionHandlerPool for description of config settings workerThreads
   @see HttpConnectionHandler for description of config settings readTimeout
   @see HttpRequest for description of config settings maxRequestSize and maxMultiPartSize
 */
@@ -62,14 +60,6 @@ private:
     /** Pool of connection handlers */
     HttpConnectionHandlerPool* pool;
 
-signals:
-
-    /**
-      Emitted when the connection handler shall process a new incoming onnection.
-      @param socketDescriptor references the accepted connection.
-    */
-    void handleConnection(int socketDescriptor);
-
 };
 
 #endif // LISTENER_H
@@ -7,62 +7,124 @@
 #include <QList>
 #include <QDir>
 #include "httpcookie.h"
+#include <string.h>
 
-HttpRequest::HttpRequest(QSettings* settings) {
+QString HttpRequest::uploadDirectory;
+QMutex HttpRequest::uploadDirectoryMutex;
+
+HttpRequest::HttpRequest(QSettings* settings)
+    : partHash(QCryptographicHash::Sha1)
+{
+    init(settings->value("maxRequestSize","16000").toInt(),settings->value("maxMultiPartSize","1000000").toInt());
+}
+
+HttpRequest::HttpRequest(int maxSize, int maxMultiPartSize)
+    : partHash(QCryptographicHash::Sha1)
+{
+    init(maxSize,maxMultiPartSize);
+}
+
+void HttpRequest::init(int maxSize, int maxMultiPartSize) {
     status=waitForRequest;
     currentSize=0;
     expectedBodySize=0;
-    maxSize=settings->value("maxRequestSize","16000").toInt();
-    maxMultiPartSize=settings->value("maxMultiPartSize","1000000").toInt();
+    multiPartState=multiPartPreamble;
+    multiPartReceived=0;
+    partFile=0;
+    this->maxSize=maxSize;
+    this->maxMultiPartSize=maxMultiPartSize;
+}
+
+static inline bool isBlank(char c) {
+    return c==' ' || c=='\t' || c=='\r' || c=='\n';
+}
+
+bool HttpRequest::readLine(const QByteArray& buffer, int& position, int& start, int& end) {
+    int newline=buffer.indexOf('\n',position);
+    if (newline<0) {
+        // Detect overflow without waiting for the end of the line
+        if (currentSize+buffer.size()-position>maxSize) {
+            qWarning("HttpRequest: received too many bytes");
+            status=abort;
+        }
+        return false;
+    }
+    currentSize+=newline+1-position;
+    start=position;
+    end=newline;
+    position=newline+1;
+    // Trim the line in place
+    const char* data=buffer.constData();
+    while (start<end && isBlank(data[start])) {
+        start++;
+    }
+    while (end>start && isBlank(data[end-1])) {
+        end--;
+    }
+    return true;
 }
 
-void HttpRequest::readRequest(QTcpSocket& socket) {
+void HttpRequest::readRequest(const char* line, int length) {
 #ifdef SUPERVERBOSE
     qDebug("HttpRequest: read request");
 #endif
-    int toRead=maxSize-currentSize+1; // allow one byte more to be able to detect overflow
-    QByteArray newData=socket.readLine(toRead).trimmed();
-    currentSize+=newData.size();
-    if (!newData.isEmpty()) {
-        QList<QByteArray> list=newData.split(' ');
-        if (list.count()!=3 || !list.at(2).contains("HTTP")) {
+    if (length>0) {
+        int first=-1;
+        int second=-1;
+        int spaces=0;
+        for (int i=0; i<length; i++) {
+            if (line[i]==' ') {
+                if (spaces==0) {
+                    first=i;
+                }
+                else if (spaces==1) {
+                    second=i;
+                }
+                spaces++;
+            }
+        }
+        if (spaces==2) {
+            version=QByteArray(line+second+1,length-second-1);
+        }
+        if (spaces!=2 || !version.contains("HTTP")) {
             qWarning("HttpRequest: received broken HTTP request, invalid first line");
             status=abort;
         }
         else {
-            method=list.at(0);
-            path=list.at(1);
-            version=list.at(2);
+            method=QByteArray(line,first);
+            path=QByteArray(line+first+1,second-first-1);
             status=waitForHeader;
         }
     }
 }
 
-void HttpRequest::readHeader(QTcpSocket& socket) {
+void HttpRequest::readHeader(const char* line, int length) {
 #ifdef SUPERVERBOSE
     qDebug("HttpRequest: read header");
 #endif
-    int toRead=maxSize-currentSize+1; // allow one byte more to be able to detect overflow
-    QByteArray newData=socket.readLine(toRead).trimmed();
-    currentSize+=newData.size();
-    int colon=newData.indexOf(':');
+    const char* colonPtr=(const char*)memchr(line,':',length);
+    int colon=colonPtr ? colonPtr-line : -1;
     if (colon>0)  {
         // Received a line with a colon - a header
-        currentHeader=newData.left(colon);
-        QByteArray value=newData.mid(colon+1).trimmed();
+        currentHeader=QByteArray(line,colon);
+        int valueStart=colon+1;
+        while (valueStart<length && isBlank(line[valueStart])) {
+            valueStart++;
+        }
+        QByteArray value(line+valueStart,length-valueStart);
         headers.insert(currentHeader,value);
 #ifdef SUPERVERBOSE
         qDebug("HttpRequest: received header %s: %s",currentHeader.data(),value.data());
 #endif
     }
-    else if (!newData.isEmpty()) {
+    else if (length>0) {
         // received another line - belongs to the previous header
 #ifdef SUPERVERBOSE
         qDebug("HttpRequest: read additional line of header");
 #endif
         // Received additional line of previous header
         if (headers.contains(currentHeader)) {
-            headers.insert(currentHeader,headers.value(currentHeader)+" "+newData);
+            headers.insert(currentHeader,headers.value(currentHeader)+" "+QByteArray(line,length));
         }
     }
     else {
@@ -81,7 +143,15 @@ void HttpRequest::readHeader(QTcpSocket& socket) {
         }
         QByteArray contentLength=getHeader("Content-Length");
         if (!contentLength.isEmpty()) {
-            expectedBodySize=contentLength.toInt();
+            bool ok=false;
+            expectedBodySize=contentLength.trimmed().toInt(&ok);
+            if (!ok || expectedBodySize<0) {
+                // A negative size would make the body reads go out of the buffer
+                qWarning("HttpRequest: invalid Content-Length");
+                expectedBodySize=0;
+                status=abort;
+                return;
+            }
         }
         if (expectedBodySize==0) {
 #ifdef SUPERVERBOSE
@@ -106,50 +176,49 @@ void HttpRequest::readHeader(QTcpSocket& socket) {
     }
 }
 
-void HttpRequest::readBody(QTcpSocket& socket) {
+void HttpRequest::readBody(const QByteArray& buffer, int& position) {
     Q_ASSERT(expectedBodySize!=0);
+    int available=buffer.size()-position;
     if (boundary.isEmpty()) {
         // normal body, no multipart
 #ifdef SUPERVERBOSE
         qDebug("HttpRequest: receive body");
 #endif
-        int toRead=expectedBodySize-bodyData.size();
-        QByteArray newData=socket.read(toRead);
-        currentSize+=newData.size();
-        bodyData.append(newData);
+        if (bodyData.isEmpty()) {
+            bodyData.reserve(expectedBodySize);
+        }
+        int toRead=qMin(expectedBodySize-bodyData.size(),available);
+        Q_ASSERT(toRead>=0);
+        bodyData.append(buffer.constData()+position,toRead);
+        position+=toRead;
+        currentSize+=toRead;
         if (bodyData.size()>=expectedBodySize) {
             status=complete;
         }
     }
     else {
-        // multipart body, store into temp file
+        // multipart body, parsed while it arrives
 #ifdef SUPERVERBOSE
         qDebug("HttpRequest: receiving multipart body");
 #endif
-        if (!tempFile.isOpen()) {
-            tempFile.open();
-        }
-        // Transfer data in 64kb blocks
-        int fileSize=tempFile.size();
-        int toRead=expectedBodySize-fileSize;
-        if (toRead>65536) {
-            toRead=65536;
-        }
-        fileSize+=tempFile.write(socket.read(toRead));
-        if (fileSize>=maxMultiPartSize) {
+        int toRead=qMin(expectedBodySize-multiPartReceived,available);
+        Q_ASSERT(toRead>=0);
+        const char* data=buffer.constData()+position;
+        position+=toRead;
+        multiPartReceived+=toRead;
+        if (multiPartReceived>=maxMultiPartSize) {
             qWarning("HttpRequest: received too many multipart bytes");
             status=abort;
+            return;
         }
-        else if (fileSize>=expectedBodySize) {
+        parseMultiPart(data,toRead);
+        if (status!=abort && multiPartReceived>=expectedBodySize) {
 #ifdef SUPERVERBOSE
             qDebug("HttpRequest: received whole multipart body");
 #endif
-            tempFile.flush();
-            if (tempFile.error()) {
-                qCritical("HttpRequest: Error writing temp file for multipart body");
+            if (multiPartState!=multiPartEpilogue) {
+                qWarning("HttpRequest: multipart body ended before its closing boundary");
             }
-            parseMultiPartFile();
-            tempFile.close();
             status=complete;
         }
     }
@@ -220,20 +289,29 @@ void HttpRequest::extractCookies() {
     headers.remove("Cookie");
 }
 
-void HttpRequest::readFromSocket(QTcpSocket& socket) {
+void HttpRequest::readFromBuffer(const QByteArray& buffer, int& position) {
     Q_ASSERT(status!=complete);
-    if (status==waitForRequest) {
-        readRequest(socket);
-    }
-    else if (status==waitForHeader) {
-        readHeader(socket);
-    }
-    else if (status==waitForBody) {
-        readBody(socket);
-    }
-    if (currentSize>maxSize) {
-        qWarning("HttpRequest: received too many bytes");
-        status=abort;
+    while (position<buffer.size() && status!=complete && status!=abort) {
+        if (status==waitForBody) {
+            readBody(buffer,position);
+        }
+        else {
+            int start;
+            int end;
+            if (!readLine(buffer,position,start,end)) {
+                break;
+            }
+            if (status==waitForRequest) {
+                readRequest(buffer.constData()+start,end-start);
+            }
+            else {
+                readHeader(buffer.constData()+start,end-start);
+            }
+        }
+        if (currentSize>maxSize) {
+            qWarning("HttpRequest: received too many bytes");
+            status=abort;
+        }
     }
     if (status==complete) {
         // Extract and decode request parameters from url and body
@@ -308,104 +386,165 @@ QByteArray HttpRequest::urlDecode(const QByteArray source) {
 }
 
 
-void HttpRequest::parseMultiPartFile() {
-    qDebug("HttpRequest: parsing multipart temp file");
-    tempFile.seek(0);
-    bool finished=false;
-    while (!tempFile.atEnd() && !finished && !tempFile.error()) {
-
-#ifdef SUPERVERBOSE
-        qDebug("HttpRequest: reading multpart headers");
-#endif
-        QByteArray fieldName;
-        QByteArray fileName;
-        while (!tempFile.atEnd() && !finished && !tempFile.error()) {
-            QByteArray line=tempFile.readLine(65536).trimmed();
-            if (line.startsWith("Content-Disposition:")) {
-                if (line.contains("form-data")) {
-                    int start=line.indexOf(" name=\"");
-                    int end=line.indexOf("\"",start+7);
-                    if (start>=0 && end>=start) {
-                        fieldName=line.mid(start+7,end-start-7);
-                    }
-                    start=line.indexOf(" filename=\"");
-                    end=line.indexOf("\"",start+11);
-                    if (start>=0 && end>=start) {
-                        fileName=line.mid(start+11,end-start-11);
+void HttpRequest::parseMultiPart(const char* data, int size) {
+    multiPartBuffer.append(data,size);
+    QByteArray delimiter="--"+boundary;
+    bool progress=true;
+    while (progress && status!=abort) {
+        progress=false;
+        if (multiPartState==multiPartPreamble) {
+            // Skip everything before the first boundary
+            int posi=multiPartBuffer.indexOf(delimiter);
+            if (posi>=0) {
+                multiPartBuffer.remove(0,posi+delimiter.size());
+                multiPartState=multiPartBoundary;
+                progress=true;
+            }
+            else if (multiPartBuffer.size()>delimiter.size()) {
+                multiPartBuffer.remove(0,multiPartBuffer.size()-delimiter.size());
+            }
+        }
+        else if (multiPartState==multiPartBoundary) {
+            // A boundary is followed by a line break, or by "--" at the end of the body
+            if (multiPartBuffer.size()>=2) {
+                if (multiPartBuffer.startsWith("--")) {
+                    multiPartState=multiPartEpilogue;
+                }
+                else {
+                    int posi=multiPartBuffer.indexOf("\r\n");
+                    if (posi<0) {
+                        break;
                     }
+                    multiPartBuffer.remove(0,posi+2);
+                    multiPartState=multiPartHeaders;
+                }
+                progress=true;
+            }
+        }
+        else if (multiPartState==multiPartHeaders) {
 #ifdef SUPERVERBOSE
-                    qDebug("HttpRequest: multipart field=%s, filename=%s",fieldName.data(),fileName.data());
+            qDebug("HttpRequest: reading multpart headers");
 #endif
+            int posi=multiPartBuffer.indexOf("\r\n");
+            if (posi>=0) {
+                QByteArray line=multiPartBuffer.left(posi).trimmed();
+                multiPartBuffer.remove(0,posi+2);
+                if (line.isEmpty()) {
+                    multiPartState=multiPartData;
                 }
                 else {
-                    qDebug("HttpRequest: ignoring unsupported content part %s",line.data());
+                    readPartHeader(line);
                 }
+                progress=true;
             }
-            else if (line.isEmpty()) {
-                break;
+            else if (multiPartBuffer.size()>65536) {
+                qWarning("HttpRequest: multipart header line is too long");
+                status=abort;
+            }
+        }
+        else if (multiPartState==multiPartData) {
+            // The data ends with a line break followed by the boundary.
+            // Keep the bytes that could be the start of it for the next round.
+            QByteArray dataDelimiter="\r\n"+delimiter;
+            int posi=multiPartBuffer.indexOf(dataDelimiter);
+            if (posi>=0) {
+                writePartData(multiPartBuffer.left(posi));
+                multiPartBuffer.remove(0,posi+dataDelimiter.size());
+                finishPart();
+                multiPartState=multiPartBoundary;
+                progress=true;
             }
+            else if (multiPartBuffer.size()>=dataDelimiter.size()) {
+                int safe=multiPartBuffer.size()-dataDelimiter.size()+1;
+                writePartData(multiPartBuffer.left(safe));
+                multiPartBuffer.remove(0,safe);
+            }
+        }
+        else {
+            multiPartBuffer.clear();
         }
+    }
+}
 
+void HttpRequest::readPartHeader(const QByteArray& line) {
+    if (line.startsWith("Content-Disposition:")) {
+        if (line.contains("form-data")) {
+            int start=line.indexOf(" name=\"");
+            int end=line.indexOf("\"",start+7);
+            if (start>=0 && end>=start) {
+                partFieldName=line.mid(start+7,end-start-7);
+            }
+            start=line.indexOf(" filename=\"");
+            end=line.indexOf("\"",start+11);
+            if (start>=0 && end>=start) {
+                partFileName=line.mid(start+11,end-start-11);
+            }
 #ifdef SUPERVERBOSE
-        qDebug("HttpRequest: reading multpart data");
-#endif
-        QTemporaryFile* uploadedFile=0;
-        QByteArray fieldValue;
-        while (!tempFile.atEnd() && !finished && !tempFile.error()) {
-            QByteArray line=tempFile.readLine(65536);
-            if (line.startsWith("--"+boundary)) {
-                // Boundary found. Until now we have collected 2 bytes too much,
-                // so remove them from the last result
-                if (fileName.isEmpty() && !fieldName.isEmpty()) {
-                    // last field was a form field
-                    fieldValue.remove(fieldValue.size()-2,2);
-                    parameters.insert(fieldName,fieldValue);
-                    qDebug("HttpRequest: set parameter %s=%s",fieldName.data(),fieldValue.data());
-                }
-                else if (!fileName.isEmpty() && !fieldName.isEmpty()) {
-                    // last field was a file
-#ifdef SUPERVERBOSE
-                    qDebug("HttpRequest: finishing writing to uploaded file");
+            qDebug("HttpRequest: multipart field=%s, filename=%s",partFieldName.data(),partFileName.data());
 #endif
-                    uploadedFile->resize(uploadedFile->size()-2);
-                    uploadedFile->flush();
-                    uploadedFile->seek(0);
-                    parameters.insert(fieldName,fileName);
-                    qDebug("HttpRequest: set parameter %s=%s",fieldName.data(),fileName.data());
-                    uploadedFiles.insert(fieldName,uploadedFile);
-                    qDebug("HttpRequest: uploaded file size is %i",(int) uploadedFile->size());
-                }
-                if (line.contains(boundary+"--")) {
-                    finished=true;
-                }
-                break;
+        }
+        else {
+            qDebug("HttpRequest: ignoring unsupported content part %s",line.data());
+        }
+    }
+}
+
+void HttpRequest::writePartData(const QByteArray& data) {
+    if (partFileName.isEmpty() && !partFieldName.isEmpty()) {
+        // this is a form field.
+        currentSize+=data.size();
+        partFieldValue.append(data);
+    }
+    else if (!partFileName.isEmpty() && !partFieldName.isEmpty()) {
+        // this is a file
+        if (!partFile) {
+            uploadDirectoryMutex.lock();
+            QString directory=uploadDirectory;
+            uploadDirectoryMutex.unlock();
+            if (!directory.isEmpty() && QDir().mkpath(directory)) {
+                partFile=new QTemporaryFile(QDir(directory).absoluteFilePath(".upload_XXXXXX"));
             }
             else {
-                if (fileName.isEmpty() && !fieldName.isEmpty()) {
-                    // this is a form field.
-                    currentSize+=line.size();
-                    fieldValue.append(line);
-                }
-                else if (!fileName.isEmpty() && !fieldName.isEmpty()) {
-                    // this is a file
-                    if (!uploadedFile) {
-                        uploadedFile=new QTemporaryFile();
-                        uploadedFile->open();
-                    }
-                    uploadedFile->write(line);
-                    if (uploadedFile->error()) {
-                        qCritical("HttpRequest: error writing temp file, %s",qPrintable(uploadedFile->errorString()));
-                    }
-                }
+                partFile=new QTemporaryFile();
             }
+            partFile->open();
+            partHash.reset();
+        }
+        partFile->write(data);
+        partHash.addData(data);
+        if (partFile->error()) {
+            qCritical("HttpRequest: error writing temp file, %s",qPrintable(partFile->errorString()));
         }
     }
-    if (tempFile.error()) {
-        qCritical("HttpRequest: cannot read temp file, %s",qPrintable(tempFile.errorString()));
+}
+
+void HttpRequest::finishPart() {
+    if (partFileName.isEmpty() && !partFieldName.isEmpty()) {
+        // last field was a form field
+        parameters.insert(partFieldName,partFieldValue);
+        qDebug("HttpRequest: set parameter %s=%s",partFieldName.data(),partFieldValue.data());
     }
+    else if (!partFileName.isEmpty() && !partFieldName.isEmpty()) {
+        // last field was a file, possibly empty
 #ifdef SUPERVERBOSE
-    qDebug("HttpRequest: finished parsing multipart temp file");
+        qDebug("HttpRequest: finishing writing to uploaded file");
 #endif
+        if (!partFile) {
+            writePartData(QByteArray());
+        }
+        partFile->flush();
+        partFile->seek(0);
+        parameters.insert(partFieldName,partFileName);
+        qDebug("HttpRequest: set parameter %s=%s",partFieldName.data(),partFileName.data());
+        delete uploadedFiles.value(partFieldName);
+        uploadedFiles.insert(partFieldName,partFile);
+        uploadedFileHashes.insert(partFieldName,partHash.result().toHex().toUpper());
+        qDebug("HttpRequest: uploaded file size is %i",(int) partFile->size());
+        partFile=0;
+    }
+    partFieldName.clear();
+    partFileName.clear();
+    partFieldValue.clear();
 }
 
 HttpRequest::~HttpRequest() {
@@ -414,6 +553,7 @@ HttpRequest::~HttpRequest() {
         file->close();
         delete file;
     }
+    delete partFile;
 }
 
 QMap<QByteArray,QTemporaryFile*> HttpRequest::getUploadedFiles() {
@@ -422,6 +562,18 @@ QMap<QByteArray,QTemporaryFile*> HttpRequest::getUploadedFiles() {
 QTemporaryFile* HttpRequest::getUploadedFile(const QByteArray fieldName) {
     return uploadedFiles.value(fieldName);
 }
+QByteArray HttpRequest::getUploadedFileHash(const QByteArray fieldName) const {
+    return uploadedFileHashes.value(fieldName);
+}
+void HttpRequest::setUploadDirectory(const QString& directory) {
+    uploadDirectoryMutex.lock();
+    uploadDirectory=directory;
+    uploadDirectoryMutex.unlock();
+}
+QString HttpRequest::getUploadDirectory() {
+    QMutexLocker locker(&uploadDirectoryMutex);
+    return uploadDirectory;
+}
 
 QByteArray HttpRequest::getCookie(const QByteArray& name) const {
     return cookies.value(name);
@@ -13,6 +13,8 @@
 #include <QSettings>
 #include <QTemporaryFile>
 #include <QUuid>
+#include <QCryptographicHash>
+#include <QMutex>
 
 /**
   This object represents a single HTTP request. It reads the request
@@ -29,6 +31,9 @@
   multipart/form-data requests (also known as file-upload), the maximum
   size of the body must not exceed maxMultiPartSize.
   The body is always a little larger than the file itself.
+  <p>
+  Multipart bodies are parsed while they arrive. Each uploaded file is written
+  once, into the upload directory, and its SHA-1 is computed on the way.
 */
 
 class HttpRequest {
@@ -45,17 +50,28 @@ public:
     */
     HttpRequest(QSettings* settings);
 
+    /**
+      Constructor with settings that the connection has read once.
+      @param maxSize Maximum size of requests in bytes
+      @param maxMultiPartSize Maximum allowed size of multipart forms in bytes
+    */
+    HttpRequest(int maxSize, int maxMultiPartSize);
+
     /**
       Destructor.
     */
     virtual ~HttpRequest();
 
     /**
-      Read the request from a socket. This method must be called repeatedly
+      Parse the request from the bytes received by the connection, as far as they go.
+      Lines are located in the buffer and only the parts kept by the request are copied.
+      The request stops at its own end, so the bytes of pipelined requests stay in the
+      buffer for the next HttpRequest. This method must be called for each new data
       until the status is RequestStatus::complete or RequestStatus::abort.
-      @param socket Source of the data
+      @param buffer Bytes received by the connection
+      @param position Position of the first byte to parse, moved behind the consumed bytes
     */
-    void readFromSocket(QTcpSocket& socket);
+    void readFromBuffer(const QByteArray& buffer, int& position);
 
     /**
       Get the status of this reqeust.
@@ -128,6 +144,22 @@ public:
     QMap<QByteArray,QTemporaryFile*> getUploadedFiles();
     QTemporaryFile* getUploadedFile(const QByteArray fieldName);
 
+    /**
+      Get the SHA-1 of an uploaded file, as an upper case hex string.
+      It is computed while the file is received.
+    */
+    QByteArray getUploadedFileHash(const QByteArray fieldName) const;
+
+    /**
+      Set the directory where uploaded files are written while they are received.
+      When it is on the same drive as their destination, uploaded files can be renamed
+      instead of being copied. The system temp directory is used when it is empty.
+    */
+    static void setUploadDirectory(const QString& directory);
+
+    /** Get the directory where uploaded files are written, or an empty string if there is none. Thread-safe. */
+    static QString getUploadDirectory();
+
     /**
       Get the value of a cookie
       @param name Name of the cookie
@@ -148,6 +180,9 @@ private:
     /** Uploaded files of the request, key is the field name. */
     QMap<QByteArray,QTemporaryFile*> uploadedFiles;
 
+    /** SHA-1 of the uploaded files, key is the field name. */
+    QMap<QByteArray,QByteArray> uploadedFileHashes;
+
     /** Received cookies */
     QMap<QByteArray,QByteArray> cookies;
 
@@ -187,25 +222,73 @@ private:
     /** Boundary of multipart/form-data body. Empty if there is no such header */
     QByteArray boundary;
 
-    /** Temp file, that is used to store the multipart/form-data body */
-    QTemporaryFile tempFile;
+    /** States of the multipart/form-data parser */
+    enum MultiPartState {multiPartPreamble, multiPartBoundary, multiPartHeaders, multiPartData, multiPartEpilogue};
+
+    /** Current state of the multipart/form-data parser */
+    MultiPartState multiPartState;
+
+    /** Received multipart bytes that could not be processed yet */
+    QByteArray multiPartBuffer;
+
+    /** Number of multipart bytes received */
+    int multiPartReceived;
 
-    /** Parset he multipart body, that has been stored in the temp file. */
-    void parseMultiPartFile();
+    /** Field name of the current part */
+    QByteArray partFieldName;
+
+    /** File name of the current part, empty if it is a form field */
+    QByteArray partFileName;
+
+    /** Value of the current part, if it is a form field */
+    QByteArray partFieldValue;
+
+    /** Destination of the current part, if it is a file */
+    QTemporaryFile* partFile;
+
+    /** SHA-1 of the current part, if it is a file */
+    QCryptographicHash partHash;
+
+    /** Directory for uploaded files */
+    static QString uploadDirectory;
+
+    /** Used to synchronize access to the upload directory */
+    static QMutex uploadDirectoryMutex;
+
+    /** Parse received bytes of the multipart body, as far as possible. */
+    void parseMultiPart(const char* data, int size);
+
+    /** Process a line of the headers of the current part. */
+    void readPartHeader(const QByteArray& line);
+
+    /** Append data to the current part. */
+    void writePartData(const QByteArray& data);
+
+    /** Store the current part, after its closing boundary has been received. */
+    void finishPart();
+
+    /** Initialize the state, called by the constructors. */
+    void init(int maxSize, int maxMultiPartSize);
+
+    /**
+      Sub-procedure of readFromBuffer(), get the next complete line.
+      @return false if the end of the line has not been received yet
+    */
+    bool readLine(const QByteArray& buffer, int& position, int& start, int& end);
 
-    /** Sub-procedure of readFromSocket(), read the first line of a request. */
-    void readRequest(QTcpSocket& socket);
+    /** Sub-procedure of readFromBuffer(), read the first line of a request. */
+    void readRequest(const char* line, int length);
 
-    /** Sub-procedure of readFromSocket(), read header lines. */
-    void readHeader(QTcpSocket& socket);
+    /** Sub-procedure of readFromBuffer(), read header lines. */
+    void readHeader(const char* line, int length);
 
-    /** Sub-procedure of readFromSocket(), read the request body. */
-    void readBody(QTcpSocket& socket);
+    /** Sub-procedure of readFromBuffer(), read the request body. */
+    void readBody(const QByteArray& buffer, int& position);
 
-    /** Sub-procedure of readFromSocket(), extract and decode request parameters. */
+    /** Sub-procedure of readFromBuffer(), extract and decode request parameters. */
     void decodeRequestParams();
 
-    /** Sub-procedure of readFromSocket(), extract cookies from headers */
+    /** Sub-procedure of readFromBuffer(), extract cookies from headers */
     void extractCookies();
 
 };
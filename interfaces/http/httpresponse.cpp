@@ -4,13 +4,30 @@
 */
 
 #include "httpresponse.h"
+#include <string.h>
 
-HttpResponse::HttpResponse(QTcpSocket* socket) {
+HttpResponse::HttpResponse(QTcpSocket* socket, HttpConnectionOutput* output, QByteArray* buffer) {
+    Q_ASSERT(output!=0);
     this->socket=socket;
+    this->output=output;
     statusCode=200;
     statusText="OK";
     sentHeaders=false;
     sentLastPart=false;
+    detached=false;
+    chunked=false;
+    if (buffer) {
+        this->buffer=buffer;
+    }
+    else {
+        this->buffer=&ownBuffer;
+    }
+    // The buffer never shrinks, so the connection does not allocate again for the next response.
+    // Its used length is tracked here, because resize(0) would free the storage with Qt4.
+    if (this->buffer->size()<1024) {
+        this->buffer->resize(1024);
+    }
+    bufferUsed=0;
 }
 
 void HttpResponse::setHeader(QByteArray name, QByteArray value) {
@@ -32,48 +49,53 @@ void HttpResponse::setStatus(int statusCode, QByteArray description) {
     statusText=description;
 }
 
-void HttpResponse::writeHeaders() {
-    Q_ASSERT(sentHeaders==false);
-    QByteArray buffer;
-    buffer.append("HTTP/1.1 ");
-    buffer.append(QByteArray::number(statusCode));
-    buffer.append(' ');
-    buffer.append(statusText);
-    buffer.append("\r\n");
-    foreach(QByteArray name, headers.keys()) {
-        buffer.append(name);
-        buffer.append(": ");
-        buffer.append(headers.value(name));
-        buffer.append("\r\n");
+void HttpResponse::appendToBuffer(const char* data, int size) {
+    if (buffer->size()<bufferUsed+size) {
+        buffer->resize(qMax(bufferUsed+size,buffer->size()*2));
     }
-    foreach(HttpCookie cookie,cookies.values()) {
-        buffer.append("Set-Cookie: ");
-        buffer.append(cookie.toByteArray());
-        buffer.append("\r\n");
-    }
-    buffer.append("\r\n");
-    writeToSocket(buffer);
-    sentHeaders=true;
+    memcpy(buffer->data()+bufferUsed,data,size);
+    bufferUsed+=size;
 }
 
-bool HttpResponse::writeToSocket(QByteArray data) {
-    int remaining=data.size();
-    char* ptr=data.data();
-    while (socket->isOpen() && remaining>0) {
-        // Wait until the previous buffer content is written out, otherwise it could become very large
-        socket->waitForBytesWritten(-1);
-        int written=socket->write(ptr,remaining);
-        if (written==-1) {
-          return false;
-        }
-        ptr+=written;
-        remaining-=written;
+void HttpResponse::appendToBuffer(const char* data) {
+    appendToBuffer(data,qstrlen(data));
+}
+
+void HttpResponse::appendToBuffer(const QByteArray& data) {
+    appendToBuffer(data.constData(),data.size());
+}
+
+QByteArray HttpResponse::usedBuffer() const {
+    return QByteArray::fromRawData(buffer->constData(),bufferUsed);
+}
+
+void HttpResponse::formatHeaders() {
+    Q_ASSERT(sentHeaders==false);
+    appendToBuffer("HTTP/1.1 ");
+    appendToBuffer(QByteArray::number(statusCode));
+    appendToBuffer(" ");
+    appendToBuffer(statusText);
+    appendToBuffer("\r\n");
+    for (QMap<QByteArray,QByteArray>::const_iterator i=headers.constBegin(); i!=headers.constEnd(); ++i) {
+        appendToBuffer(i.key());
+        appendToBuffer(": ");
+        appendToBuffer(i.value());
+        appendToBuffer("\r\n");
     }
-    return true;
+    for (QMap<QByteArray,HttpCookie>::const_iterator i=cookies.constBegin(); i!=cookies.constEnd(); ++i) {
+        appendToBuffer("Set-Cookie: ");
+        appendToBuffer(i.value().toByteArray());
+        appendToBuffer("\r\n");
+    }
+    appendToBuffer("\r\n");
+    QByteArray transferEncoding=headers.value("Transfer-Encoding");
+    chunked=transferEncoding=="chunked" || transferEncoding=="Chunked";
+    sentHeaders=true;
 }
 
 void HttpResponse::write(QByteArray data, bool lastPart) {
     Q_ASSERT(sentLastPart==false);
+    bufferUsed=0;
     if (sentHeaders==false) {
         QByteArray connectionMode=headers.value("Connection");
         if (!headers.contains("Content-Length") && !headers.contains("Transfer-Encoding") && connectionMode!="close" && connectionMode!="Close") {
@@ -84,26 +106,34 @@ void HttpResponse::write(QByteArray data, bool lastPart) {
                 headers.insert("Content-Length",QByteArray::number(data.size()));
             }
         }
-        writeHeaders();
+        formatHeaders();
     }
-    bool chunked=headers.value("Transfer-Encoding")=="chunked" || headers.value("Transfer-Encoding")=="Chunked";
     if (chunked) {
+        // Size line after the headers, end of chunk and last chunk after the data
         if (data.size()>0) {
-            QByteArray buffer=QByteArray::number(data.size(),16);
-            buffer.append("\r\n");
-            writeToSocket(buffer);
-            writeToSocket(data);
-            writeToSocket("\r\n");
+            appendToBuffer(QByteArray::number(data.size(),16));
+            appendToBuffer("\r\n");
+            if (lastPart) {
+                output->write(usedBuffer(),data,QByteArray::fromRawData("\r\n0\r\n\r\n",7));
+            }
+            else {
+                output->write(usedBuffer(),data,QByteArray::fromRawData("\r\n",2));
+            }
+        }
+        else {
+            if (lastPart) {
+                appendToBuffer("0\r\n\r\n");
+            }
+            if (bufferUsed>0) {
+                output->write(usedBuffer());
+            }
         }
     }
     else {
-        writeToSocket(data);
+        output->write(usedBuffer(),data);
     }
     if (lastPart) {
-        if (chunked) {
-            writeToSocket("0\r\n\r\n");
-        }
-        else if (!headers.contains("Content-Length")) {
+        if (!chunked && !headers.contains("Content-Length")) {
             socket->disconnectFromHost();
         }
         sentLastPart=true;
@@ -111,11 +141,40 @@ void HttpResponse::write(QByteArray data, bool lastPart) {
 }
 
 
+bool HttpResponse::writeFile(QFile& file, qint64 offset, qint64 length, bool lastPart) {
+    Q_ASSERT(sentLastPart==false);
+    Q_ASSERT(headers.contains("Content-Length"));
+    if (sentHeaders==false) {
+        bufferUsed=0;
+        formatHeaders();
+        output->write(usedBuffer());
+    }
+    bool success=output->writeFile(file,offset,length);
+    if (lastPart) {
+        sentLastPart=true;
+    }
+    return success;
+}
+
+
 bool HttpResponse::hasSentLastPart() const {
     return sentLastPart;
 }
 
 
+QTcpSocket* HttpResponse::detach() {
+    Q_ASSERT(sentHeaders==true);
+    Q_ASSERT(sentLastPart==false);
+    detached=true;
+    return socket;
+}
+
+
+bool HttpResponse::isDetached() const {
+    return detached;
+}
+
+
 void HttpResponse::setCookie(const HttpCookie& cookie) {
     Q_ASSERT(sentHeaders==false);
     if (!cookie.getName().isEmpty()) {
@@ -9,7 +9,9 @@
 #include <QMap>
 #include <QString>
 #include <QTcpSocket>
+#include <QFile>
 #include "httpcookie.h"
+#include "httpconnectionoutput.h"
 
 /**
   This object represents a HTTP response, in particular the response headers.
@@ -31,6 +33,14 @@
   many small packets. In case of large responses (e.g. file downloads), a Content-Length
   header should be set before calling write(). Web Browsers use that information to display
   a progress bar.
+  <p>
+  The status line, the headers and the chunk framing are formatted into a buffer that the
+  connection reuses for all its responses, and sent together with the body in one system
+  call when the socket has nothing queued.
+  <p>
+  Writing never waits for the client. What the client does not read yet is queued in the
+  output of the connection, and the connection handler does not process further requests
+  until that queue is drained.
 */
 
 class HttpResponse {
@@ -40,8 +50,11 @@ public:
     /**
       Constructor.
       @param socket used to write the response
+      @param output output of the connection, all data is written through it
+      @param buffer reusable buffer of the connection for the headers and the chunk framing,
+      or 0 to use a buffer of the response
     */
-    HttpResponse(QTcpSocket* socket);
+    HttpResponse(QTcpSocket* socket, HttpConnectionOutput* output, QByteArray* buffer=0);
 
     /**
       Set a HTTP response header
@@ -84,12 +97,39 @@ public:
     */
     void write(QByteArray data, bool lastPart=false);
 
+    /**
+      Write a part of a file as body data to the socket. The Content-Length header
+      must be set before, because files are never sent in chunked mode.
+      <p>
+      The part is queued in the output of the connection and sent by its event loop after
+      service() has returned, on Linux by the kernel from the page cache with sendfile().
+      Data written afterwards follows the file. The caller may close the file at once.
+      @param file File to read from
+      @param offset Position of the first byte to send
+      @param length Number of bytes to send
+      @param lastPart Indicator, if this is the last part of the response.
+      @return false if the file could not be queued
+    */
+    bool writeFile(QFile& file, qint64 offset, qint64 length, bool lastPart=false);
+
     /**
       Indicates wheter the body has been sent completely. Used by the connection
       handler to terminate the body automatically when necessary.
     */
     bool hasSentLastPart() const;
 
+    /**
+      Hand the connection over to the caller, who keeps writing to the socket after
+      the request handler returned, e.g. for a stream of server-sent events. The
+      connection handler then neither terminates the body nor waits for further
+      requests on this connection. The headers must have been sent before.
+      @return Socket of the connection, it stays owned by the connection handler
+    */
+    QTcpSocket* detach();
+
+    /** Indicates whether the connection has been handed over by detach() */
+    bool isDetached() const;
+
     /**
       Set a cookie. Cookies are sent together with the headers when the first
       call to write() occurs.
@@ -104,6 +144,9 @@ private:
     /** Socket for writing output */
     QTcpSocket* socket;
 
+    /** Output of the connection */
+    HttpConnectionOutput* output;
+
     /** HTTP status code*/
     int statusCode;
 
@@ -116,18 +159,38 @@ private:
     /** Indicator whether the body has been sent completely */
     bool sentLastPart;
 
+    /** Indicator whether the connection has been handed over */
+    bool detached;
+
+    /** Indicator whether the body is sent in chunked mode, known when the headers have been sent */
+    bool chunked;
+
+    /** Buffer for the headers and the chunk framing, it only grows */
+    QByteArray* buffer;
+    /** Number of bytes used in the buffer */
+    int bufferUsed;
+
+    /** Buffer used when the connection does not provide one */
+    QByteArray ownBuffer;
+
+    /** Append bytes to the used part of the buffer, growing it when necessary */
+    void appendToBuffer(const char* data, int size);
+    /** Append a null terminated string to the used part of the buffer */
+    void appendToBuffer(const char* data);
+    /** Append bytes to the used part of the buffer */
+    void appendToBuffer(const QByteArray& data);
+    /** The used part of the buffer, without copying it */
+    QByteArray usedBuffer() const;
+
     /** Cookies */
     QMap<QByteArray,HttpCookie> cookies;
 
-    /** Write raw data to the socket. This method blocks until all bytes have been passed to the TCP buffer */
-    bool writeToSocket(QByteArray data);
-
     /**
-      Write the response HTTP status and headers to the socket.
-      Calling this method is optional, because writeBody() calls
+      Format the response HTTP status and headers into the buffer.
+      Calling this method is optional, because write() calls
       it automatically when required.
     */
-    void writeHeaders();
+    void formatHeaders();
 
 };
 
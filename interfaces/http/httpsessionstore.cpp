@@ -11,10 +11,17 @@ HttpSessionStore::HttpSessionStore(QSettings* settings, QObject* parent)
     :QObject(parent)
 {
     this->settings=settings;
-    connect(&cleanupTimer,SIGNAL(timeout()),this,SLOT(timerEvent()));
-    cleanupTimer.start(60000);
     cookieName=settings->value("cookieName","sessionid").toByteArray();
+    cookiePath=settings->value("cookiePath").toByteArray();
+    cookieComment=settings->value("cookieComment").toByteArray();
+    cookieDomain=settings->value("cookieDomain").toByteArray();
     expirationTime=settings->value("expirationTime",3600000).toInt();
+    for (int i=0; i<sessionShardCount; i++) {
+        shards[i].tick=0;
+    }
+    wheelStart=QDateTime::currentMSecsSinceEpoch();
+    connect(&cleanupTimer,SIGNAL(timeout()),this,SLOT(cleanup()));
+    cleanupTimer.start(tickInterval);
     qDebug("HttpSessionStore: Sessions expire after %i milliseconds",expirationTime);
 }
 
@@ -23,85 +30,155 @@ HttpSessionStore::~HttpSessionStore()
     cleanupTimer.stop();
 }
 
-QByteArray HttpSessionStore::getSessionId(HttpRequest& request, HttpResponse& response) {
+HttpSessionStore::SessionShard& HttpSessionStore::shardOf(const QByteArray& id) {
+    return shards[qHash(id)%sessionShardCount];
+}
+
+QByteArray HttpSessionStore::getCookieSessionId(HttpRequest& request, HttpResponse& response) {
     // The session ID in the response has priority because this one will be used in the next request.
-    mutex.lock();
-    // Get the session ID from the response cookie
     QByteArray sessionId=response.getCookies().value(cookieName).getValue();
     if (sessionId.isEmpty()) {
         // Get the session ID from the request cookie
         sessionId=request.getCookie(cookieName);
     }
+    return sessionId;
+}
+
+QByteArray HttpSessionStore::getSessionId(HttpRequest& request, HttpResponse& response) {
+    QByteArray sessionId=getCookieSessionId(request,response);
     // Clear the session ID if there is no such session in the storage.
     if (!sessionId.isEmpty()) {
-        if (!sessions.contains(sessionId)) {
+        SessionShard& shard=shardOf(sessionId);
+        shard.mutex.lock();
+        bool found=shard.sessions.contains(sessionId);
+        shard.mutex.unlock();
+        if (!found) {
             qDebug("HttpSessionStore: received invalid session cookie with ID %s",sessionId.data());
             sessionId.clear();
         }
     }
-    mutex.unlock();
     return sessionId;
 }
 
 HttpSession HttpSessionStore::getSession(HttpRequest& request, HttpResponse& response, bool allowCreate) {
-    QByteArray sessionId=getSessionId(request,response);
-    mutex.lock();
+    QByteArray sessionId=getCookieSessionId(request,response);
     if (!sessionId.isEmpty()) {
-        HttpSession session=sessions.value(sessionId);
+        SessionShard& shard=shardOf(sessionId);
+        shard.mutex.lock();
+        HttpSession session=shard.sessions.value(sessionId);
+        shard.mutex.unlock();
         if (!session.isNull()) {
-            mutex.unlock();
             session.setLastAccess();
             return session;
         }
+        qDebug("HttpSessionStore: received invalid session cookie with ID %s",sessionId.data());
     }
     // Need to create a new session
     if (allowCreate) {
-        QByteArray cookieName=settings->value("cookieName","sessionid").toByteArray();
-        QByteArray cookiePath=settings->value("cookiePath").toByteArray();
-        QByteArray cookieComment=settings->value("cookieComment").toByteArray();
-        QByteArray cookieDomain=settings->value("cookieDomain").toByteArray();
         HttpSession session(true);
         qDebug("HttpSessionStore: create new session with ID %s",session.getId().data());
-        sessions.insert(session.getId(),session);
+        SessionShard& shard=shardOf(session.getId());
+        shard.mutex.lock();
+        shard.sessions.insert(session.getId(),session);
+        schedule(shard,session.getId(),session.getLastAccess()+expirationTime);
+        shard.mutex.unlock();
         response.setCookie(HttpCookie(cookieName,session.getId(),expirationTime/1000,cookiePath,cookieComment,cookieDomain));
-        mutex.unlock();
         return session;
     }
     // Return a null session
-    mutex.unlock();
     return HttpSession();
 }
 
 HttpSession HttpSessionStore::getSession(const QByteArray id) {
-    mutex.lock();
-    HttpSession session=sessions.value(id);
-    mutex.unlock();
+    SessionShard& shard=shardOf(id);
+    shard.mutex.lock();
+    HttpSession session=shard.sessions.value(id);
+    shard.mutex.unlock();
     session.setLastAccess();
     return session;
 }
 
-void HttpSessionStore::timerEvent(QTimerEvent *) {
-    // Todo: find a way to delete sessions only if no controller is accessing them
-    mutex.lock();
+void HttpSessionStore::schedule(SessionShard& shard, const QByteArray& id, qint64 expiry) {
+    // Number of ticks from now, rounded up
+    qint64 ticks=(expiry-wheelStart+tickInterval-1)/tickInterval-(qint64)shard.tick;
+    if (ticks<1) {
+        ticks=1;
+    }
+    quint64 target=shard.tick+ticks;
+    if (ticks<wheelSize) {
+        shard.wheel[0][target%wheelSize].append(id);
+    }
+    else if (ticks<wheelSize*wheelSize) {
+        shard.wheel[1][(target/wheelSize)%wheelSize].append(id);
+    }
+    else {
+        shard.wheel[1][(shard.tick/wheelSize+wheelSize-1)%wheelSize].append(id);
+    }
+}
+
+int HttpSessionStore::advance(SessionShard& shard) {
     qint64 now=QDateTime::currentMSecsSinceEpoch();
-    QMap<QByteArray,HttpSession>::iterator i = sessions.begin();
-    while (i != sessions.end()) {
-        QMap<QByteArray,HttpSession>::iterator prev = i;
-        ++i;
-        HttpSession session=prev.value();
-        qint64 lastAccess=session.getLastAccess();
-        if (now-lastAccess>expirationTime) {
-            qDebug("HttpSessionStore: session %s expired",session.getId().data());
-            sessions.erase(prev);
+    shard.tick++;
+    // Move the sessions of the next level 1 slot down to level 0
+    if (shard.tick%wheelSize==0) {
+        QList<QByteArray> cascade;
+        cascade.swap(shard.wheel[1][(shard.tick/wheelSize)%wheelSize]);
+        foreach(QByteArray id, cascade) {
+            HttpSession session=shard.sessions.value(id);
+            if (!session.isNull()) {
+                schedule(shard,id,session.getLastAccess()+expirationTime);
+            }
+        }
+    }
+    // Sessions accessed in the meantime are rescheduled instead of expired
+    int expired=0;
+    QList<QByteArray> due;
+    due.swap(shard.wheel[0][shard.tick%wheelSize]);
+    foreach(QByteArray id, due) {
+        HttpSession session=shard.sessions.value(id);
+        if (session.isNull()) {
+            continue;
+        }
+        qint64 expiry=session.getLastAccess()+expirationTime;
+        if (expiry<=now) {
+#ifdef SUPERVERBOSE
+            qDebug("HttpSessionStore: session %s expired",id.data());
+#endif
+            shard.sessions.remove(id);
+            expired++;
+        }
+        else {
+            schedule(shard,id,expiry);
         }
     }
-    mutex.unlock();
+    return expired;
+}
+
+void HttpSessionStore::cleanup() {
+    // Todo: find a way to delete sessions only if no controller is accessing them
+    // Catch up with the clock, the timer may fire late
+    quint64 target=(QDateTime::currentMSecsSinceEpoch()-wheelStart)/tickInterval;
+    int expired=0;
+    int remaining=0;
+    for (int i=0; i<sessionShardCount; i++) {
+        SessionShard& shard=shards[i];
+        shard.mutex.lock();
+        while (shard.tick<target) {
+            expired+=advance(shard);
+        }
+        remaining+=shard.sessions.count();
+        shard.mutex.unlock();
+    }
+    if (expired>0) {
+        qDebug("HttpSessionStore: %i sessions expired, %i remaining",expired,remaining);
+    }
 }
 
 
 /** Delete a session */
 void HttpSessionStore::removeSession(HttpSession session) {
-    mutex.lock();
-    sessions.remove(session.getId());
-    mutex.unlock();
+    SessionShard& shard=shardOf(session.getId());
+    shard.mutex.lock();
+    shard.sessions.remove(session.getId());
+    shard.mutex.unlock();
 }
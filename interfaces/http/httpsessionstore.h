@@ -7,7 +7,8 @@
 #define HTTPSESSIONSTORE_H
 
 #include <QObject>
-#include <QMap>
+#include <QHash>
+#include <QList>
 #include <QTimer>
 #include <QMutex>
 #include "httpsession.h"
@@ -27,6 +28,12 @@
   cookieComment=Session ID
   cookieDomain=stefanfrings.de
   </pre></code>
+  <p>
+  Sessions are spread over shards with their own lock, selected by the hash of the ID,
+  so concurrent requests rarely wait for each other. Expiry uses a hierarchical timing
+  wheel per shard: each tick only looks at the sessions that may expire in that second,
+  instead of walking all sessions. Accessing a session only renews its timestamp, the
+  wheel reschedules it when its slot comes up.
 */
 
 class HttpSessionStore : public QObject {
@@ -55,6 +62,7 @@ public:
        Get the session of a HTTP request, eventually create a new one.
        This method is thread safe. New sessions can only be created before
        the first byte has been written to the HTTP response.
+       An existing session is found and renewed with a single lock.
        @param request Used to get the session cookie
        @param response Used to get and set the new session cookie
        @param allowCreate can be set to false, to disable the automatic creation of a new session.
@@ -77,28 +85,77 @@ public:
 
 private:
 
+    /** Number of slots of each wheel level */
+    static const int wheelSize=64;
+
+    /** Number of session shards */
+    static const int sessionShardCount=16;
+
+    /** Duration of a tick of the timing wheel (in ms) */
+    static const int tickInterval=1000;
+
+    /**
+      Part of the sessions with its own lock and timing wheel. Level 0 has a slot
+      per tick, level 1 a slot per wheelSize ticks. Sessions further away wait in
+      the last slot of level 1 and are rescheduled when it comes up.
+    */
+    struct SessionShard {
+        QHash<QByteArray,HttpSession> sessions;
+        QList<QByteArray> wheel[2][wheelSize];
+        quint64 tick;
+        QMutex mutex;
+    };
+
     /** Configuration settings */
     QSettings* settings;
 
-    /** Storage for the sessions */
-    QMap<QByteArray,HttpSession> sessions;
+    /** Storage for the sessions, selected by the hash of the ID */
+    SessionShard shards[sessionShardCount];
 
-    /** Timer to remove expired sessions */
+    /** Timer to advance the timing wheels */
     QTimer cleanupTimer;
 
+    /** Time when the timing wheels started (in ms since epoch) */
+    qint64 wheelStart;
+
     /** Name of the session cookie */
     QByteArray cookieName;
 
+    /** Path of the session cookie */
+    QByteArray cookiePath;
+
+    /** Comment of the session cookie */
+    QByteArray cookieComment;
+
+    /** Domain of the session cookie */
+    QByteArray cookieDomain;
+
     /** Time when sessions expire (in ms)*/
     int expirationTime;
 
-    /** Used to synchronize threads */
-    QMutex mutex;
+    /** Get the shard that stores a session ID */
+    SessionShard& shardOf(const QByteArray& id);
+
+    /** Get the session ID from the cookies of the response or the request */
+    QByteArray getCookieSessionId(HttpRequest& request, HttpResponse& response);
+
+    /**
+      Put a session ID in the slot of the timing wheel matching its expiry.
+      The shard must be locked.
+    */
+    void schedule(SessionShard& shard, const QByteArray& id, qint64 expiry);
+
+    /**
+      Advance the timing wheel of a shard by one tick, expire or reschedule the
+      sessions of the current slot. The shard must be locked.
+      @return Number of expired sessions
+    */
+    int advance(SessionShard& shard);
 
 private slots:
 
-    /** Called every minute to cleanup expired sessions. */
-    void timerEvent(QTimerEvent*);
+    /** Called every tick to advance the timing wheels and cleanup expired sessions. */
+    void cleanup();
 };
 
 #endif // HTTPSESSIONSTORE_H
@@ -7,6 +7,11 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QDateTime>
+#include <QLocale>
+#include <QTime>
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
 
 StaticFileController::StaticFileController(QSettings* settings, QObject* parent)
     :HttpRequestHandler(parent)
@@ -26,104 +31,440 @@ StaticFileController::StaticFileController(QSettings* settings, QObject* parent)
     }
     qDebug("StaticFileController: docroot=%s, encoding=%s, maxAge=%i",qPrintable(docroot),qPrintable(encoding),maxAge);
     maxCachedFileSize=settings->value("maxCachedFileSize","65536").toInt();
-    cache.setMaxCost(settings->value("cacheSize","1000000").toInt());
+    int cacheSize=settings->value("cacheSize","1000000").toInt();
+    for (int i=0; i<cacheShardCount; i++) {
+        cacheShards[i].cache.setMaxCost(cacheSize/cacheShardCount);
+        cacheShards[i].requests=0;
+        cacheShards[i].hits=0;
+        cacheShards[i].notModified=0;
+        cacheShards[i].bytesSaved=0;
+    }
     cacheTimeout=settings->value("cacheTime","60000").toInt();
-    qDebug("StaticFileController: cache timeout=%i, size=%i",cacheTimeout,cache.maxCost());
+    precompressed=settings->value("precompressed",false).toBool();
+    prefix=settings->value("prefix").toByteArray();
+    qDebug("StaticFileController: cache timeout=%i, size=%i",cacheTimeout,cacheSize);
+}
+
+
+void StaticFileController::setDocroot(const QString& docroot) {
+    QMutexLocker locker(&docrootMutex);
+    if (this->docroot==docroot) {
+        return;
+    }
+    this->docroot=docroot;
+    // Cached entries belong to the previous docroot
+    for (int i=0; i<cacheShardCount; i++) {
+        QMutexLocker shardLocker(&cacheShards[i].mutex);
+        cacheShards[i].cache.clear();
+    }
+    qDebug("StaticFileController: docroot=%s",qPrintable(docroot));
+}
+
+
+QString StaticFileController::getDocroot() {
+    QMutexLocker locker(&docrootMutex);
+    return docroot;
 }
 
 
 void StaticFileController::service(HttpRequest& request, HttpResponse& response) {
     QByteArray path=request.getPath();
+    if (!prefix.isEmpty() && path.startsWith(prefix)) {
+        path=path.mid(prefix.size());
+    }
     // Forbid access to files outside the docroot directory
-    if (path.startsWith("/..")) {
+    if (path.startsWith("/..") || path.contains("/../") || path.endsWith("/..")) {
         qWarning("StaticFileController: somebody attempted to access a file outside the docroot directory");
         response.setStatus(403,"forbidden");
         response.write("403 forbidden",true);
+        return;
+    }
+    // Prefer the precompressed variant of a text file, unless a part of the file is requested
+    if (precompressed && isCompressible(path) && request.getHeader("Range").isEmpty() && request.getHeader("Accept-Encoding").contains("gzip")) {
+        if (serveFile(request,response,path+".gz",true)) {
+            return;
+        }
     }
+    if (!serveFile(request,response,path,false)) {
+        response.setStatus(404,"not found");
+        response.write("404 not found",true);
+    }
+}
+
+bool StaticFileController::serveFile(HttpRequest& request, HttpResponse& response, const QByteArray& path, bool encoded) {
+    QByteArray contentPath=encoded ? path.left(path.size()-3) : path;
+    if (precompressed && isCompressible(contentPath)) {
+        response.setHeader("Vary","Accept-Encoding");
+    }
+    if (encoded) {
+        response.setHeader("Content-Encoding","gzip");
+    }
+
     // Check if we have the file in cache
+    CacheShard& shard=cacheShards[qHash(path)%cacheShardCount];
     qint64 now=QDateTime::currentMSecsSinceEpoch();
-    mutex.lock();
-    CacheEntry* entry=cache.object(path);
-    if (entry && (cacheTimeout==0 || entry->created>now-cacheTimeout)) {       
-        QByteArray document=entry->document; //copy the cached document, because other threads may destroy the cached entry immediately after mutex unlock.
-        mutex.unlock();
+    bool cached=false, fresh=false;
+    QByteArray document, contentType, etag;
+    QString fileName;
+    FileStamp stamp;
+    shard.mutex.lock();
+    CacheEntry* entry=shard.cache.object(path);
+    if (entry) {
+        // copy the cached document (shared, not duplicated), because other threads may destroy the cached entry immediately after mutex unlock.
+        document=entry->document;
+        contentType=entry->contentType;
+        etag=entry->etag;
+        fileName=entry->fileName;
+        stamp=entry->stamp;
+        cached=true;
+        fresh=(cacheTimeout==0 || entry->created>now-cacheTimeout);
+    }
+    shard.mutex.unlock();
+
+    // An expired entry stays valid as long as the file did not change
+    if (cached && !fresh) {
+        FileStamp current;
+        if (readStamp(fileName,&current) && current==stamp) {
+            fresh=true;
+            shard.mutex.lock();
+            entry=shard.cache.object(path);
+            if (entry && entry->stamp==stamp) {
+                entry->created=now;
+            }
+            shard.mutex.unlock();
+        }
+    }
+    if (fresh) {
+#ifdef SUPERVERBOSE
         qDebug("StaticFileController: Cache hit for %s",path.data());
-        setContentType(path,response);
-        response.setHeader("Cache-Control","max-age="+QByteArray::number(maxAge/1000));
-        response.write(document);
+#endif
+        countRequest(shard,true,writeContent(request,response,0,document,contentType,stamp,etag));
+        return true;
+    }
+
+    // The file is not in cache or it changed.
+    // If the filename is a directory, append index.html.
+    qDebug("StaticFileController: Cache miss for %s",path.data());
+    docrootMutex.lock();
+    QString root=docroot;
+    docrootMutex.unlock();
+    if (root.isEmpty()) {
+        return false;
+    }
+    fileName=root+path;
+    if (!encoded && QFileInfo(fileName).isDir()) {
+        fileName+="/index.html";
+        contentPath+="/index.html";
+    }
+    QFile file(fileName);
+    if (!file.exists()) {
+        if (encoded) {
+            response.getHeaders().remove("Content-Encoding");
+        }
+        return false;
+    }
+    qDebug("StaticFileController: Open file %s",qPrintable(file.fileName()));
+    if (!file.open(QIODevice::ReadOnly) || !readStamp(fileName,&stamp)) {
+        qWarning("StaticFileController: Cannot open existing file %s for reading",qPrintable(file.fileName()));
+        response.getHeaders().remove("Content-Encoding");
+        response.setStatus(403,"forbidden");
+        response.write("403 forbidden",true);
+        return true;
+    }
+    contentType=getContentType(contentPath);
+    etag=toEtag(stamp);
+    qint64 bytesSaved=0;
+    if (file.size()<=maxCachedFileSize) {
+        // Return the file content and store it also in the cache
+        entry=new CacheEntry();
+        while (!file.atEnd() && !file.error()) {
+            entry->document.append(file.read(65536));
+        }
+        entry->created=now;
+        entry->fileName=fileName;
+        entry->contentType=contentType;
+        entry->stamp=stamp;
+        entry->etag=etag;
+        document=entry->document;
+        // Not cached when the docroot changed meanwhile, same lock order as setDocroot()
+        docrootMutex.lock();
+        if (root==docroot) {
+            shard.mutex.lock();
+            shard.cache.insert(path,entry,entry->document.size());
+            shard.mutex.unlock();
+        }
+        else {
+            delete entry;
+        }
+        docrootMutex.unlock();
+        bytesSaved=writeContent(request,response,0,document,contentType,stamp,etag);
+    }
+    else {
+        // Return the file content, do not store in cache
+        QTime timer;
+        timer.start();
+        bytesSaved=writeContent(request,response,&file,QByteArray(),contentType,stamp,etag);
+        qDebug("StaticFileController: Queued %s in %i ms",qPrintable(file.fileName()),timer.elapsed());
+    }
+    file.close();
+    countRequest(shard,false,bytesSaved);
+    return true;
+}
+
+qint64 StaticFileController::writeContent(HttpRequest& request, HttpResponse& response, QFile* file, const QByteArray& document, const QByteArray& contentType, const FileStamp& stamp, const QByteArray& etag) {
+    QDateTime lastModified=QDateTime::fromMSecsSinceEpoch(stamp.modified);
+    QByteArray lastModifiedDate=toHttpDate(lastModified);
+    qint64 size=file ? stamp.size : document.size();
+    if (!contentType.isEmpty()) {
+        response.setHeader("Content-Type",contentType);
+    }
+    response.setHeader("Cache-Control","max-age="+QByteArray::number(maxAge/1000));
+    response.setHeader("Last-Modified",lastModifiedDate);
+    response.setHeader("ETag",etag);
+    response.setHeader("Accept-Ranges","bytes");
+
+    // The browser already has this version of the file
+    if (isNotModified(request,etag,lastModified)) {
+        response.getHeaders().remove("Content-Type");
+        response.setStatus(304,"not modified");
+        response.write(QByteArray(),true);
+        return size;
+    }
+
+    // Ranges of an older version of the file are not applicable, send it entirely
+    QList< QPair<qint64,qint64> > ranges;
+    bool satisfiable=true;
+    QByteArray ifRange=request.getHeader("If-Range");
+    if (ifRange.isEmpty() || ifRange==etag || ifRange==lastModifiedDate) {
+        ranges=parseRanges(request.getHeader("Range"),size,&satisfiable);
+    }
+    if (!satisfiable) {
+        response.setStatus(416,"requested range not satisfiable");
+        response.setHeader("Content-Range","bytes */"+QByteArray::number(size));
+        response.write(QByteArray(),true);
+    }
+    else if (ranges.isEmpty()) {
+        response.setHeader("Content-Length",QByteArray::number(size));
+        writeBytes(response,file,document,0,size,true);
+    }
+    else if (ranges.count()==1) {
+        qint64 first=ranges.first().first, last=ranges.first().second;
+        response.setStatus(206,"partial content");
+        response.setHeader("Content-Range","bytes "+QByteArray::number(first)+"-"+QByteArray::number(last)+"/"+QByteArray::number(size));
+        response.setHeader("Content-Length",QByteArray::number(last-first+1));
+        writeBytes(response,file,document,first,last-first+1,true);
     }
     else {
-        mutex.unlock();
-        qDebug("StaticFileController: Cache miss for %s",path.data());
-        // The file is not in cache.
-        // If the filename is a directory, append index.html.
-        if (QFileInfo(docroot+path).isDir()) {
-            path+="/index.html";
+        // Multiple ranges are sent as parts of a multipart/byteranges body
+        QByteArray boundary="RANGE_"+QByteArray::number(QDateTime::currentMSecsSinceEpoch(),16);
+        QList<QByteArray> partHeaders;
+        qint64 contentLength=0;
+        for (int i=0; i<ranges.count(); i++) {
+            QByteArray partHeader="\r\n--"+boundary+"\r\n";
+            if (!contentType.isEmpty()) {
+                partHeader+="Content-Type: "+contentType+"\r\n";
+            }
+            partHeader+="Content-Range: bytes "+QByteArray::number(ranges.at(i).first)+"-"+QByteArray::number(ranges.at(i).second)+"/"+QByteArray::number(size)+"\r\n\r\n";
+            partHeaders.append(partHeader);
+            contentLength+=partHeader.size()+ranges.at(i).second-ranges.at(i).first+1;
+        }
+        QByteArray closingBoundary="\r\n--"+boundary+"--\r\n";
+        contentLength+=closingBoundary.size();
+        response.setStatus(206,"partial content");
+        response.setHeader("Content-Type","multipart/byteranges; boundary="+boundary);
+        response.setHeader("Content-Length",QByteArray::number(contentLength));
+        for (int i=0; i<ranges.count(); i++) {
+            response.write(partHeaders.at(i));
+            writeBytes(response,file,document,ranges.at(i).first,ranges.at(i).second-ranges.at(i).first+1,false);
+        }
+        response.write(closingBoundary,true);
+    }
+    return 0;
+}
+
+void StaticFileController::writeBytes(HttpResponse& response, QFile* file, const QByteArray& document, qint64 offset, qint64 length, bool lastPart) {
+    if (file) {
+        response.writeFile(*file,offset,length,lastPart);
+    }
+    else {
+        response.write(document.mid(offset,length),lastPart);
+    }
+}
+
+QList< QPair<qint64,qint64> > StaticFileController::parseRanges(const QByteArray& value, qint64 size, bool* satisfiable) const {
+    QList< QPair<qint64,qint64> > ranges;
+    *satisfiable=true;
+    if (!value.startsWith("bytes=")) {
+        return ranges;
+    }
+    QList<QByteArray> specs=value.mid(6).split(',');
+    // Too many ranges are rather an attack than a seek, send the whole file instead
+    if (specs.count()>16) {
+        return ranges;
+    }
+    foreach(QByteArray spec, specs) {
+        spec=spec.trimmed();
+        int dash=spec.indexOf('-');
+        if (dash<0) {
+            return QList< QPair<qint64,qint64> >();
         }
-        QFile file(docroot+path);
-        if (file.exists()) {
-            qDebug("StaticFileController: Open file %s",qPrintable(file.fileName()));
-            if (file.open(QIODevice::ReadOnly)) {
-                setContentType(path,response);
-                response.setHeader("Cache-Control","max-age="+QByteArray::number(maxAge/1000));
-                if (file.size()<=maxCachedFileSize) {
-                    // Return the file content and store it also in the cache
-                    entry=new CacheEntry();
-                    while (!file.atEnd() && !file.error()) {
-                        QByteArray buffer=file.read(65536);
-                        response.write(buffer);
-                        entry->document.append(buffer);
-                    }
-                    entry->created=now;
-                    mutex.lock();
-                    cache.insert(request.getPath(),entry,entry->document.size());
-                    mutex.unlock();
-                }
-                else {
-                    // Return the file content, do not store in cache
-                    while (!file.atEnd() && !file.error()) {
-                        response.write(file.read(65536));
-                    }
-                }
-                file.close();
+        bool okFirst=true, okLast=true;
+        if (dash==0) {
+            // Suffix range, the last bytes of the file
+            qint64 suffix=spec.mid(1).toLongLong(&okLast);
+            if (!okLast) {
+                return QList< QPair<qint64,qint64> >();
             }
-            else {
-                qWarning("StaticFileController: Cannot open existing file %s for reading",qPrintable(file.fileName()));
-                response.setStatus(403,"forbidden");
-                response.write("403 forbidden",true);
+            if (suffix>0 && size>0) {
+                ranges.append(qMakePair(qMax((qint64)0,size-suffix),size-1));
             }
+            continue;
         }
-        else {
-            response.setStatus(404,"not found");
-            response.write("404 not found",true);
+        qint64 first=spec.left(dash).toLongLong(&okFirst);
+        qint64 last=(dash==spec.size()-1) ? size-1 : spec.mid(dash+1).toLongLong(&okLast);
+        if (!okFirst || !okLast || (dash<spec.size()-1 && last<first)) {
+            // Syntactically invalid, the header must be ignored
+            return QList< QPair<qint64,qint64> >();
+        }
+        if (first<size) {
+            ranges.append(qMakePair(first,qMin(last,size-1)));
         }
     }
+    if (ranges.isEmpty()) {
+        *satisfiable=false;
+    }
+    return ranges;
+}
+
+QByteArray StaticFileController::toHttpDate(const QDateTime& date) {
+    return QLocale::c().toString(date.toUTC(),"ddd, dd MMM yyyy hh:mm:ss").toLatin1()+" GMT";
+}
+
+QDateTime StaticFileController::fromHttpDate(const QByteArray& value) {
+    QDateTime date=QLocale::c().toDateTime(QString::fromLatin1(value.left(25)),"ddd, dd MMM yyyy hh:mm:ss");
+    date.setTimeSpec(Qt::UTC);
+    return date;
 }
 
-void StaticFileController::setContentType(QString fileName, HttpResponse& response) const {
+bool StaticFileController::readStamp(const QString& fileName, FileStamp* stamp) {
+#ifdef Q_OS_UNIX
+    struct stat status;
+    if (::stat(QFile::encodeName(fileName).constData(),&status)!=0) {
+        return false;
+    }
+    stamp->inode=status.st_ino;
+    stamp->size=status.st_size;
+    stamp->modified=(qint64)status.st_mtime*1000;
+#else
+    QFileInfo info(fileName);
+    if (!info.exists()) {
+        return false;
+    }
+    stamp->inode=0;
+    stamp->size=info.size();
+    stamp->modified=info.lastModified().toMSecsSinceEpoch();
+#endif
+    return true;
+}
+
+QByteArray StaticFileController::toEtag(const FileStamp& stamp) {
+    return "\""+QByteArray::number(stamp.inode,16)+"-"+QByteArray::number(stamp.size,16)+"-"+QByteArray::number(stamp.modified,16)+"\"";
+}
+
+bool StaticFileController::isNotModified(HttpRequest& request, const QByteArray& etag, const QDateTime& lastModified) const {
+    // If-None-Match takes precedence over If-Modified-Since
+    QByteArray ifNoneMatch=request.getHeader("If-None-Match");
+    if (!ifNoneMatch.isEmpty()) {
+        foreach(QByteArray tag, ifNoneMatch.split(',')) {
+            tag=tag.trimmed();
+            if (tag.startsWith("W/")) {
+                tag=tag.mid(2);
+            }
+            if (tag=="*" || tag==etag) {
+                return true;
+            }
+        }
+        return false;
+    }
+    QByteArray ifModifiedSince=request.getHeader("If-Modified-Since");
+    if (!ifModifiedSince.isEmpty()) {
+        QDateTime since=fromHttpDate(ifModifiedSince);
+        return since.isValid() && lastModified.toTime_t()<=since.toTime_t();
+    }
+    return false;
+}
+
+bool StaticFileController::isCompressible(const QByteArray& path) const {
+    return path.endsWith(".html") || path.endsWith(".htm") || path.endsWith(".css") || path.endsWith(".js") || path.endsWith(".txt") || path.endsWith(".json") || path.endsWith(".svg");
+}
+
+void StaticFileController::countRequest(CacheShard& shard, bool hit, qint64 bytesSaved) {
+    shard.mutex.lock();
+    shard.requests++;
+    if (hit) {
+        shard.hits++;
+    }
+    if (bytesSaved>0) {
+        shard.notModified++;
+        shard.bytesSaved+=bytesSaved;
+    }
+    bool reportNow=(shard.requests%1000==0);
+    shard.mutex.unlock();
+    if (reportNow) {
+        report();
+    }
+}
+
+void StaticFileController::report() {
+    qint64 requests=0, hits=0, notModified=0, bytesSaved=0;
+    for (int i=0; i<cacheShardCount; i++) {
+        cacheShards[i].mutex.lock();
+        requests+=cacheShards[i].requests;
+        hits+=cacheShards[i].hits;
+        notModified+=cacheShards[i].notModified;
+        bytesSaved+=cacheShards[i].bytesSaved;
+        cacheShards[i].mutex.unlock();
+    }
+    qDebug("StaticFileController: %lli requests, %lli%% cache hits, %lli not modified, %lli KB saved",requests,(requests>0)?(100*hits/requests):0,notModified,bytesSaved/1024);
+}
+
+QByteArray StaticFileController::getContentType(QString fileName) const {
     if (fileName.endsWith(".png")) {
-        response.setHeader("Content-Type", "image/png");
+        return "image/png";
     }
     else if (fileName.endsWith(".jpg")) {
-        response.setHeader("Content-Type", "image/jpeg");
+        return "image/jpeg";
     }
     else if (fileName.endsWith(".gif")) {
-        response.setHeader("Content-Type", "image/gif");
+        return "image/gif";
     }
     else if (fileName.endsWith(".pdf")) {
-        response.setHeader("Content-Type", "application/pdf");
+        return "application/pdf";
     }
     else if (fileName.endsWith(".txt")) {
-        response.setHeader("Content-Type", qPrintable("text/plain; charset="+encoding));
+        return ("text/plain; charset="+encoding).toLatin1();
     }
     else if (fileName.endsWith(".html") || fileName.endsWith(".htm")) {
-        response.setHeader("Content-Type", qPrintable("text/html; charset="+encoding));
+        return ("text/html; charset="+encoding).toLatin1();
     }
     else if (fileName.endsWith(".css")) {
-        response.setHeader("Content-Type", "text/css");
+        return "text/css";
     }
     else if (fileName.endsWith(".js")) {
-        response.setHeader("Content-Type", "text/javascript");
+        return "text/javascript";
+    }
+    else if (fileName.endsWith(".mp4") || fileName.endsWith(".m4v")) {
+        return "video/mp4";
+    }
+    else if (fileName.endsWith(".mov")) {
+        return "video/quicktime";
+    }
+    else if (fileName.endsWith(".webm")) {
+        return "video/webm";
+    }
+    else if (fileName.endsWith(".mp3")) {
+        return "audio/mpeg";
     }
     // Todo: add all of your content types
+    return QByteArray();
 }
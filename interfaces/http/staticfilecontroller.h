@@ -11,6 +11,8 @@
 #include "httprequesthandler.h"
 #include <QCache>
 #include <QMutex>
+#include <QDateTime>
+#include <QPair>
 
 /**
   Delivers static files. It is usually called by the applications main request handler when
@@ -24,15 +26,35 @@
   cacheTime=60000
   cacheSize=1000000
   maxCachedFileSize=65536
+  precompressed=false
+  prefix=
   </pre></code>
   The path is relative to the directory of the config file. In case of windows, if the
   settings are in the registry, the path is relative to the current working directory.
+  The docroot can be changed later with setDocroot(), e.g. when it follows a document
+  that the application opened.
+  <p>
+  When the controller is mounted under a path like /media, the prefix is removed from
+  the request path before the file is looked up in the docroot.
   <p>
   The encoding is sent to the web browser in case of text and html files.
   <p>
   The cache improves performance of small files when loaded from a network
-  drive. Large files are not cached. Files are cached as long as possible,
-  when cacheTime=0. The maxAge value (in msec!) controls the remote browsers cache.
+  drive. Large files are not cached. The cache is split in shards with their own lock,
+  so that threads serving different files do not wait for each other. After cacheTime,
+  a cached file is validated against the inode, size and modification time of the file
+  and kept when it did not change. Files are cached as long as possible, when cacheTime=0.
+  The maxAge value (in msec!) controls the remote browsers cache.
+  <p>
+  Each response carries an ETag and a Last-Modified header, and requests with a matching
+  If-None-Match or If-Modified-Since header are answered with 304 not modified.
+  When precompressed is true and the browser accepts gzip, a file.gz next to a text file
+  is sent instead of the file itself.
+  <p>
+  Single and multiple byte ranges are supported (206 partial content), so that browsers
+  can seek in large media files. Ranges are only honored when an If-Range header matches
+  the ETag or the Last-Modified date. Files larger than maxCachedFileSize are sent straight from the
+  file with HttpResponse::writeFile().
   <p>
   Do not instantiate this class in each request, because this would make the file cache
   useless. Better create one instance during start-up and call it when the application
@@ -50,6 +72,15 @@ public:
     /** Generates the response */
     void service(HttpRequest& request, HttpResponse& response);
 
+    /**
+      Change the root directory of documents, the cache is cleared when it differs.
+      An empty docroot serves no file at all. Thread-safe.
+    */
+    void setDocroot(const QString& docroot);
+
+    /** Get the root directory of documents. Thread-safe. */
+    QString getDocroot();
+
 private:
 
     /** Encoding of text files */
@@ -58,28 +89,112 @@ private:
     /** Root directory of documents */
     QString docroot;
 
+    /** Protects the docroot while it is changed */
+    QMutex docrootMutex;
+
+    /** Path under which the controller is mounted, removed from the request path */
+    QByteArray prefix;
+
     /** Maximum age of files in the browser cache */
     int maxAge;    
 
+    /** Identity of a version of a file */
+    struct FileStamp {
+        quint64 inode;
+        qint64 size;
+        qint64 modified;
+        bool operator==(const FileStamp& other) const { return inode==other.inode && size==other.size && modified==other.modified; }
+    };
+
     struct CacheEntry {
         QByteArray document;
         qint64 created;
+        QString fileName;
+        QByteArray contentType;
+        FileStamp stamp;
+        QByteArray etag;
     };
 
+    /** Part of the cache with its own lock and statistics */
+    struct CacheShard {
+        QCache<QString,CacheEntry> cache;
+        QMutex mutex;
+        qint64 requests;
+        qint64 hits;
+        qint64 notModified;
+        qint64 bytesSaved;
+    };
+
+    /** Number of cache shards */
+    static const int cacheShardCount=8;
+
     /** Timeout for each cached file */
     int cacheTimeout;
 
     /** Maximum size of files in cache, larger files are not cached */
     int maxCachedFileSize;
 
-    /** Cache storage */
-    QCache<QString,CacheEntry> cache;
+    /** Send precompressed variants of text files */
+    bool precompressed;
+
+    /** Cache storage, selected by the hash of the path */
+    CacheShard cacheShards[cacheShardCount];
+
+    /**
+      Send a file from the cache or from the docroot.
+      @param path Path of the file relative to the docroot
+      @param encoded Indicates that the file is the gzip variant of the path without .gz
+      @return false if the file does not exist
+    */
+    bool serveFile(HttpRequest& request, HttpResponse& response, const QByteArray& path, bool encoded);
+
+    /** Read the inode, size and modification time of a file. Returns false if it does not exist. */
+    static bool readStamp(const QString& fileName, FileStamp* stamp);
+
+    /** Build an entity tag from the identity of a file */
+    static QByteArray toEtag(const FileStamp& stamp);
+
+    /** Returns true if the If-None-Match or If-Modified-Since header of the request matches the file */
+    bool isNotModified(HttpRequest& request, const QByteArray& etag, const QDateTime& lastModified) const;
+
+    /** Returns true if files of this type are worth to be sent compressed */
+    bool isCompressible(const QByteArray& path) const;
+
+    /** Update the statistics of a shard and report them from time to time */
+    void countRequest(CacheShard& shard, bool hit, qint64 bytesSaved);
+
+    /** Log the hit ratio and the bytes saved by 304 responses */
+    void report();
+
+    /** Get the content-type depending on the ending of the filename, or an empty string if unknown */
+    QByteArray getContentType(QString file) const;
+
+    /**
+      Send the document or a part of it, as requested by the conditional and Range headers.
+      @param file Opened file to send, or 0 to send the document
+      @param document Content of the file when it is cached
+      @param contentType Content-Type header, may be empty
+      @param stamp Identity of the file
+      @param etag Entity tag of the file
+      @return the number of bytes saved by a 304 response, or 0
+    */
+    qint64 writeContent(HttpRequest& request, HttpResponse& response, QFile* file, const QByteArray& document, const QByteArray& contentType, const FileStamp& stamp, const QByteArray& etag);
+
+    /** Send the bytes from offset to offset+length of the file, or of the document if the file is 0 */
+    void writeBytes(HttpResponse& response, QFile* file, const QByteArray& document, qint64 offset, qint64 length, bool lastPart);
+
+    /**
+      Parse the value of a Range header into a list of first and last byte positions.
+      @param satisfiable Set to false if none of the ranges overlaps the file
+      @return the ranges, or an empty list if the whole file shall be sent
+    */
+    QList< QPair<qint64,qint64> > parseRanges(const QByteArray& value, qint64 size, bool* satisfiable) const;
 
-    /** Used to synchronize cache access for threads */
-    QMutex mutex;
+    /** Format a date as specified by RFC 1123 for HTTP headers */
+    static QByteArray toHttpDate(const QDateTime& date);
 
-    /** Set a content-type header in the response depending on the ending of the filename */
-    void setContentType(QString file, HttpResponse& response) const;
+    /** Parse a date formatted as specified by RFC 1123 */
+    static QDateTime fromHttpDate(const QByteArray& value);
 };
 
 #endif // STATICFILECONTROLLER_H
@@ -0,0 +1,282 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "projectapicontroller.h"
+
+void ProjectApiWriter::append(const QByteArray &data) {
+    buffer += data;
+    if(buffer.size() > 16384)
+        flush();
+}
+void ProjectApiWriter::appendString(const QString &value) {
+    append(escape(value));
+}
+void ProjectApiWriter::appendNumber(qreal value) {
+    append(QByteArray::number(value, 'g', 12));
+}
+void ProjectApiWriter::appendMetadata(const QMetaDictionnay &metadata) {
+    append("{");
+    bool firstCategory = true;
+    QMapIterator<QString, QMetaMap> categoryIterator(metadata);
+    while(categoryIterator.hasNext()) {
+        categoryIterator.next();
+        if(!firstCategory)
+            append(",");
+        appendString(categoryIterator.key());
+        append(":{");
+        bool firstKey = true;
+        QMapIterator<QString, MetadataElement> keyIterator(categoryIterator.value());
+        while(keyIterator.hasNext()) {
+            keyIterator.next();
+            if(!firstKey)
+                append(",");
+            appendString(keyIterator.key());
+            append(":");
+            appendString(keyIterator.value().toString());
+            firstKey = false;
+        }
+        append("}");
+        firstCategory = false;
+    }
+    append("}");
+}
+const QByteArray ProjectApiWriter::escape(const QString &value) {
+    //Runs of safe characters are copied as is, the UTF-8 conversion is done once so surrogate pairs stay together
+    QString escaped;
+    escaped.reserve(value.length() + 2);
+    escaped += QLatin1Char('"');
+    const QChar *characters = value.constData();
+    int run = 0;
+    for(int index = 0 ; index < value.length() ; index++) {
+        ushort code = characters[index].unicode();
+        if((code >= 0x20) && (code != '"') && (code != '\\'))
+            continue;
+        escaped += value.midRef(run, index - run);
+        if(     code == '"')    escaped += QLatin1String("\\\"");
+        else if(code == '\\')   escaped += QLatin1String("\\\\");
+        else if(code == '\n')   escaped += QLatin1String("\\n");
+        else if(code == '\r')   escaped += QLatin1String("\\r");
+        else if(code == '\t')   escaped += QLatin1String("\\t");
+        else                    escaped += QString("\\u%1").arg(code, 4, 16, QLatin1Char('0'));
+        run = index + 1;
+    }
+    escaped += value.midRef(run);
+    escaped += QLatin1Char('"');
+    return escaped.toUtf8();
+}
+void ProjectApiWriter::flush(bool lastPart) {
+    response->write(buffer, lastPart);
+    buffer.clear();
+}
+
+
+ProjectApiController::ProjectApiController(QObject *parent) :
+    HttpRequestHandler(parent) {
+}
+
+void ProjectApiController::service(HttpRequest& request, HttpResponse& response) {
+    QTime timer;
+    timer.start();
+    QByteArray path = request.getPath();
+
+    //Requests keep their snapshot alive, even if a newer one is published meanwhile
+    QSharedPointer<const ProjectSnapshot> snapshot = ProjectSnapshot::current();
+    if(!snapshot) {
+        response.setStatus(503, "no project");
+        response.write("no project", true);
+        return;
+    }
+
+    bool documentIdOk = false;
+    quint32 documentId = 0;
+    if(path.startsWith("/api/documents/"))
+        documentId = path.mid(15).toUInt(&documentIdOk);
+
+    if((path != "/api/documents") && (path != "/api/tags") && (!documentIdOk)) {
+        response.setStatus(404, "not found");
+        response.write("not found", true);
+        return;
+    }
+    if((documentIdOk) && (documentId >= (quint32)snapshot->documents.count())) {
+        response.setStatus(404, "unknown document");
+        response.write("unknown document", true);
+        return;
+    }
+
+    response.setHeader("Content-Type", "application/json; charset=UTF-8");
+    response.setHeader("Cache-Control", "no-cache");
+    ProjectApiWriter writer(&response);
+    if(path == "/api/documents")    serviceDocuments(request, writer, snapshot.data());
+    else if(path == "/api/tags")    serviceTags(request, writer, snapshot.data());
+    else                            serviceDocument(request, writer, snapshot.data(), documentId);
+    writer.flush(true);
+
+    if((Global::falseProject) || (timer.elapsed() > 50))
+        qDebug("[API] %s on revision %d in %d ms", path.constData(), snapshot->revision, timer.elapsed());
+}
+
+void ProjectApiController::serviceDocuments(HttpRequest& request, ProjectApiWriter &writer, const ProjectSnapshot *snapshot) {
+    quint32 offset = request.getParameter("offset").toUInt();
+    quint32 limit  = qBound((quint32)1, (request.getParameter("limit").isEmpty())?(100):(request.getParameter("limit").toUInt()), (quint32)1000);
+    QString type     = QString::fromUtf8(request.getParameter("type")).toLower();
+    QString search   = QString::fromUtf8(request.getParameter("search")).toLower();
+    QString category = QString::fromUtf8(request.getParameter("category"));
+    QString key      = QString::fromUtf8(request.getParameter("key"));
+    QString value    = QString::fromUtf8(request.getParameter("value")).toLower();
+    QString text     = QString::fromUtf8(request.getParameter("text"));
+
+    //Full-text query on the index, best scores first
+    QList< QPair<quint32, quint32> > documentIds;
+    QHash<quint32, quint32> scores;
+    if(!text.isEmpty()) {
+        scores = Metadata::index.query(text);
+        for(quint32 documentId = 0 ; documentId < (quint32)snapshot->documents.count() ; documentId++)
+            if(scores.contains(snapshot->documents.at(documentId).documentId))
+                documentIds << qMakePair(scores.value(snapshot->documents.at(documentId).documentId), documentId);
+        qStableSort(documentIds.begin(), documentIds.end(), ProjectApiController::sortByScore);
+    }
+    else
+        for(quint32 documentId = 0 ; documentId < (quint32)snapshot->documents.count() ; documentId++)
+            documentIds << qMakePair((quint32)0, documentId);
+
+    writer.append("{\"revision\":" + QByteArray::number(snapshot->revision) + ",\"offset\":" + QByteArray::number(offset) + ",\"items\":[");
+    quint32 total = 0;
+    for(qint32 index = 0 ; index < documentIds.count() ; index++) {
+        quint32 documentId = documentIds.at(index).second;
+        const ProjectSnapshotDocument &document = snapshot->documents.at(documentId);
+        if((!type.isEmpty()) && (!document.type.toLower().startsWith(type)))
+            continue;
+        if((!search.isEmpty()) && (!document.name.toLower().contains(search)))
+            continue;
+        if((!key.isEmpty()) && (!document.versions.isEmpty())) {
+            const QMetaDictionnay &metadata = document.versions.last();
+            if(!metadata.value(category).value(key).toString().toLower().contains(value))
+                continue;
+        }
+        if((total >= offset) && (total < offset + limit)) {
+            if(total > offset)
+                writer.append(",");
+            writer.append("{\"id\":" + QByteArray::number(documentId) + ",\"name\":");
+            writer.appendString(document.name);
+            writer.append(",\"type\":");
+            writer.appendString(document.type);
+            writer.append(",\"path\":");
+            writer.appendString(document.path);
+            writer.append(",\"versions\":" + QByteArray::number(document.versions.count()));
+            if(!text.isEmpty())
+                writer.append(",\"score\":" + QByteArray::number(documentIds.at(index).first));
+            writer.append("}");
+        }
+        total++;
+    }
+    writer.append("],\"total\":" + QByteArray::number(total) + "}");
+}
+
+void ProjectApiController::serviceDocument(HttpRequest& request, ProjectApiWriter &writer, const ProjectSnapshot *snapshot, quint32 documentId) {
+    const ProjectSnapshotDocument &document = snapshot->documents.at(documentId);
+    bool versionOk = false;
+    qint32 version = request.getParameter("version").toInt(&versionOk);
+
+    writer.append("{\"revision\":" + QByteArray::number(snapshot->revision) + ",\"id\":" + QByteArray::number(documentId) + ",\"name\":");
+    writer.appendString(document.name);
+    writer.append(",\"type\":");
+    writer.appendString(document.type);
+    writer.append(",\"path\":");
+    writer.appendString(document.path);
+    writer.append(",\"versions\":[");
+    bool first = true;
+    for(qint32 versionIndex = 0 ; versionIndex < document.versions.count() ; versionIndex++) {
+        if((versionOk) && (versionIndex != version))
+            continue;
+        if(!first)
+            writer.append(",");
+        writer.append("{\"version\":" + QByteArray::number(versionIndex) + ",\"metadata\":");
+        writer.appendMetadata(document.versions.at(versionIndex));
+        writer.append("}");
+        first = false;
+    }
+    writer.append("]}");
+}
+
+void ProjectApiController::serviceTags(HttpRequest& request, ProjectApiWriter &writer, const ProjectSnapshot *snapshot) {
+    quint32 offset = request.getParameter("offset").toUInt();
+    quint32 limit  = qBound((quint32)1, (request.getParameter("limit").isEmpty())?(100):(request.getParameter("limit").toUInt()), (quint32)1000);
+    bool fromOk = false, toOk = false, documentOk = false;
+    qreal   from       = request.getParameter("from").toDouble(&fromOk);
+    qreal   to         = request.getParameter("to").toDouble(&toOk);
+    quint32 documentId = request.getParameter("document").toUInt(&documentOk);
+    bool    displayed  = (request.getParameter("displayed") == "1");
+    QString criteria   = QString::fromUtf8(request.getParameter("criteria")).toLower();
+    QString value      = QString::fromUtf8(request.getParameter("value")).toLower();
+
+    //Time range starts at the first tag that may overlap it
+    QVector<ProjectSnapshotTag>::const_iterator tagIterator = (fromOk)?(snapshot->tagsFrom(from)):(snapshot->tags.constBegin());
+
+    writer.append("{\"revision\":" + QByteArray::number(snapshot->revision) + ",\"offset\":" + QByteArray::number(offset) + ",\"items\":[");
+    quint32 total = 0;
+    for(; tagIterator != snapshot->tags.constEnd() ; ++tagIterator) {
+        const ProjectSnapshotTag &tag = *tagIterator;
+        if((toOk) && (tag.timeStart > to))
+            break;
+        if((fromOk) && (tag.timeEnd < from))
+            continue;
+        if((documentOk) && (tag.document != documentId))
+            continue;
+        if((displayed) && (!tag.displayed))
+            continue;
+        if((!criteria.isEmpty()) && (getCriteria(tag, criteria).toLower() != value))
+            continue;
+        if((total >= offset) && (total < offset + limit)) {
+            if(total > offset)
+                writer.append(",");
+            writer.append("{\"document\":" + QByteArray::number(tag.document) + ",\"name\":");
+            writer.appendString(snapshot->documents.at(tag.document).name);
+            writer.append(",\"version\":" + QByteArray::number(tag.version) + ",\"start\":");
+            writer.appendNumber(tag.timeStart);
+            writer.append(",\"end\":");
+            writer.appendNumber(tag.timeEnd);
+            if(     tag.type == TagTypeContextualMilestone) writer.append(",\"type\":\"milestone\"");
+            else if(tag.type == TagTypeContextualTime)      writer.append(",\"type\":\"time\"");
+            else                                            writer.append(",\"type\":\"global\"");
+            writer.append(",\"displayed\":" + QByteArray((tag.displayed)?("true"):("false")));
+            QStringList criterias = QStringList() << "sort" << "color" << "cluster" << "text" << "filter" << "groupe";
+            foreach(const QString &criteriaName, criterias) {
+                writer.append(",\"" + criteriaName.toUtf8() + "\":");
+                writer.appendString(getCriteria(tag, criteriaName));
+            }
+            writer.append("}");
+        }
+        total++;
+    }
+    writer.append("],\"total\":" + QByteArray::number(total) + "}");
+}
+
+const QString ProjectApiController::getCriteria(const ProjectSnapshotTag &tag, const QString &criteria) {
+    if(     criteria == "sort")     return tag.sort;
+    else if(criteria == "color")    return tag.color;
+    else if(criteria == "cluster")  return tag.cluster;
+    else if(criteria == "text")     return tag.text;
+    else if(criteria == "filter")   return tag.filter;
+    else if(criteria == "groupe")   return tag.groupe;
+    return QString();
+}
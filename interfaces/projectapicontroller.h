@@ -0,0 +1,80 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROJECTAPICONTROLLER_H
+#define PROJECTAPICONTROLLER_H
+
+#include <QTime>
+#include "core/projectsnapshot.h"
+#include "interfaces/http/httprequest.h"
+#include "interfaces/http/httpresponse.h"
+#include "interfaces/http/httprequesthandler.h"
+
+class ProjectApiWriter {
+public:
+    explicit ProjectApiWriter(HttpResponse *_response) { response = _response; }
+
+private:
+    HttpResponse *response;
+    QByteArray    buffer;
+
+public:
+    void append      (const QByteArray &data);
+    void appendString(const QString &value);
+    void appendNumber(qreal value);
+    void appendMetadata(const QMetaDictionnay &metadata);
+    void flush(bool lastPart = false);
+public:
+    static const QByteArray escape(const QString &value);
+};
+
+/**
+  Read-only JSON queries over the last snapshot of the project:
+  <code><pre>
+  GET /api/documents?offset=0&limit=100&type=video&search=name&category=Rekall&key=Author&value=...&text=words*
+  GET /api/documents/12?version=0
+  GET /api/tags?offset=0&limit=100&from=10&to=60&displayed=1&document=12&criteria=color&value=...
+  </pre></code>
+  Requests never touch the project itself, they only read the snapshot that was
+  current when they started. Lists are streamed in chunks and end with their total.
+  The text parameter is a full-text query on the metadata index, its results are
+  ranked by score.
+*/
+class ProjectApiController : public HttpRequestHandler {
+    Q_OBJECT
+    Q_DISABLE_COPY(ProjectApiController);
+
+public:
+    explicit ProjectApiController(QObject *parent = 0);
+
+public:
+    void service(HttpRequest& request, HttpResponse& response);
+private:
+    void serviceDocuments(HttpRequest& request, ProjectApiWriter &writer, const ProjectSnapshot *snapshot);
+    void serviceDocument (HttpRequest& request, ProjectApiWriter &writer, const ProjectSnapshot *snapshot, quint32 documentId);
+    void serviceTags     (HttpRequest& request, ProjectApiWriter &writer, const ProjectSnapshot *snapshot);
+    static const QString getCriteria(const ProjectSnapshotTag &tag, const QString &criteria);
+    static bool sortByScore(const QPair<quint32, quint32> &first, const QPair<quint32, quint32> &second) { return first.first > second.first; }
+};
+
+#endif // PROJECTAPICONTROLLER_H
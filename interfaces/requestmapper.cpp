@@ -0,0 +1,49 @@
+/*
+    This file is part of Rekall.
+    Copyright (C) 2013-2014
+
+    Project Manager: Clarisse Bardiot
+    Development & interactive design: Guillaume Jacquemin & Guillaume Marais (http://www.buzzinglight.com)
+
+    This file was written by Guillaume Jacquemin.
+
+    Rekall is a free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "requestmapper.h"
+
+RequestMapper::RequestMapper(FileUploadController *_upload, StaticFileController *_media, QObject *parent) :
+    HttpRequestHandler(parent) {
+    upload = _upload;
+    media  = _media;
+    api    = new ProjectApiController(this);
+    events = new EventStreamController(this);
+}
+
+void RequestMapper::service(HttpRequest& request, HttpResponse& response) {
+    QByteArray path = request.getPath();
+    if(path.startsWith("/api/"))        api->service(request, response);
+    else if(path == "/events")          events->service(request, response);
+    else if(path.startsWith("/media/")) serviceMedia(request, response);
+    else                                upload->service(request, response);
+}
+void RequestMapper::serviceMedia(HttpRequest& request, HttpResponse& response) {
+    //Files of the opened project, the docroot is set by Rekall when a project is opened or closed
+    if(media->getDocroot().isEmpty()) {
+        response.setStatus(503, "no project");
+        response.write("no project", true);
+        return;
+    }
+    media->service(request, response);
+}
@@ -26,28 +26,41 @@
 QIcon UiFileItem::iconFile;
 QIcon UiFileItem::iconFolder;
 bool  UiFileItem::showDateTime = true;
-QStringList UiFileItem::forbiddenDirs;
-QStringList UiFileItem::allowedExtensions;
+QSet<QString> UiFileItem::forbiddenDirs;
+QSet<QString> UiFileItem::allowedExtensions;
 
 UiFileItem::UiFileItem(const QFileInfo &file, UiFileItem *_parent, WatcherBase *_watcher) :
     QObject(_parent), UiSyncItem(_parent) {
     isOpened = false;
     currentDepth = -1;
+    isPopulated  = false;
     watcher = _watcher;
 
     //allowedExtensions << "nxscore" << "nxscript" << "nxstyle" << "iannix";
-    forbiddenDirs << "rekall_cache";
+    if(forbiddenDirs.isEmpty())
+        forbiddenDirs << "rekall_cache";
 
     if(!watcher) {
         watcher = Global::watcher;
-        connect(watcher->watcher, SIGNAL(directoryChanged(QString)), SLOT(fileWatcherDirChanged(QString)));
-        connect(watcher->watcher, SIGNAL(fileChanged(QString)),      SLOT(fileWatcherFileChanged(QString)));
+        connect(watcher, SIGNAL(directoryChanged(QString)), SLOT(fileWatcherDirChanged(QString)));
+        connect(watcher, SIGNAL(fileChanged(QString)),      SLOT(fileWatcherFileChanged(QString)));
     }
     //qDebug("[CREATION FILE] %s", qPrintable(file.absoluteFilePath()));
     isFile = true;
     populate(file);
     highlight();
 }
+UiFileItem::~UiFileItem() {
+    //Children unregister while the root index is still alive
+    qDeleteAll(takeChildren());
+    QString key = pathKey(filename.file);
+    UiFileItem *root = getRoot();
+    if(root->itemsByPath.value(key) == this) {
+        root->itemsByPath.remove(key);
+        if(Global::currentProject)
+            Global::currentProject->linkChutierItem(key, this, false);
+    }
+}
 
 const QString UiFileItem::dateToString(const QDateTime &date) {
     quint16 daysTo = date.daysTo(QDateTime::currentDateTime());
@@ -109,20 +122,22 @@ void UiFileItem::setData(int column, int role, const QVariant &value) {
 
 void UiFileItem::populate(const QFileInfo &file) {
     setFlags(Qt::ItemIsEnabled | Qt::ItemIsEditable | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled);
-    filename = file;
+    setFile(file);
     filename.lastWatcherUpdate = QDateTime::currentDateTime();
     if(filename.file.isDir()) {
         isFile = false;
         QString filepath = filename.file.absoluteFilePath();
         if(filepath.endsWith("/")) {
             filepath.chop(1);
-            filename = QFileInfo(filepath);
+            setFile(QFileInfo(filepath));
         }
         if(parentItem)  setFlags(Qt::ItemIsEnabled | Qt::ItemIsEditable | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled | Qt::ItemIsDropEnabled);
         else            setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDropEnabled);
         for(quint16 colIndex = 0 ; colIndex < 3 ; colIndex++)
             setForeground(colIndex, Qt::lightGray);
         setIcon(0, iconFolder);
+        //Children are listed on expansion
+        setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
     }
     else if(filename.file.isFile()) {
         isFile  = true;
@@ -181,7 +196,7 @@ bool UiFileItem::fileRename(const QFileInfo &source, const QFileInfo &destinatio
         QFileInfo correctDestination = fileGetName(destination);
         if(QFile::rename(source.absoluteFilePath(), correctDestination.absoluteFilePath())) {
             if(item)
-                item->filename = QFileInfo(correctDestination.absoluteFilePath());
+                item->setFile(QFileInfo(correctDestination.absoluteFilePath()));
             return true;
         }
     }
@@ -190,45 +205,100 @@ bool UiFileItem::fileRename(const QFileInfo &source, const QFileInfo &destinatio
 
 
 UiFileItem* UiFileItem::find(const QFileInfo &search, QTreeWidget *tree) {
-    for(quint16 i = 0 ; i < tree->topLevelItemCount() ; i++) {
-        UiFileItem *item = ((UiFileItem*)tree->topLevelItem(i))->find(search);
+    //Each root indexes its own subtree
+    QString key = pathKey(search);
+    for(quint16 rootIndex = 0 ; rootIndex < tree->topLevelItemCount() ; rootIndex++) {
+        UiFileItem *root = dynamic_cast<UiFileItem*>(tree->topLevelItem(rootIndex));
+        if(root) {
+            UiFileItem *item = root->itemsByPath.value(key, 0);
+            if(item)
+                return item;
+        }
+    }
+    return 0;
+}
+UiFileItem* UiFileItem::ensure(const QFileInfo &search, QTreeWidget *tree) {
+    UiFileItem *item = find(search, tree);
+    if(item)
+        return item;
+
+    //Lists the folders leading to the file, as if they were expanded
+    QString key = pathKey(search);
+    for(quint16 rootIndex = 0 ; rootIndex < tree->topLevelItemCount() ; rootIndex++) {
+        UiFileItem *root = dynamic_cast<UiFileItem*>(tree->topLevelItem(rootIndex));
+        if(!root)
+            continue;
+        QString rootPath = pathKey(root->filename.file);
+        if(!key.startsWith(rootPath + "/"))
+            continue;
+
+        item = root;
+        QString itemPath = rootPath;
+        foreach(const QString &component, key.mid(rootPath.length() + 1).split("/", QString::SkipEmptyParts)) {
+            if(!item->isPopulated)
+                item->syncWith(0);
+            itemPath += "/" + component;
+            item = root->itemsByPath.value(itemPath, 0);
+            if(!item)
+                break;
+        }
         if(item)
             return item;
     }
     return 0;
 }
 UiFileItem* UiFileItem::find(const QFileInfo &search) {
-    if(filename.file == search)
-        return this;
-    else {
-        for(quint16 childIndex = 0 ; childIndex < childCount() ; childIndex++) {
-            UiFileItem *item = ((UiFileItem*)child(childIndex))->find(search);
-            if(item)
-                return item;
-        }
-    }
+    //Only items in this subtree
+    UiFileItem *item = getRoot()->itemsByPath.value(pathKey(search), 0);
+    for(UiSyncItem *ancestor = item ; ancestor ; ancestor = ancestor->parentItem)
+        if(ancestor == this)
+            return item;
     return 0;
 }
+const QString UiFileItem::pathKey(const QFileInfo &file) {
+    return QDir::cleanPath(file.absoluteFilePath());
+}
+UiFileItem* UiFileItem::getRoot() {
+    UiSyncItem *root = this;
+    while(root->parentItem)
+        root = root->parentItem;
+    return (UiFileItem*)root;
+}
+void UiFileItem::setFile(const QFileInfo &file) {
+    QString key = pathKey(filename.file);
+    UiFileItem *root = getRoot();
+    if(root->itemsByPath.value(key) == this)
+        root->itemsByPath.remove(key);
+    if(Global::currentProject)
+        Global::currentProject->linkChutierItem(key, this, false);
+    filename = file;
+    root->itemsByPath.insert(pathKey(filename.file), this);
+    if(Global::currentProject)
+        Global::currentProject->linkChutierItem(pathKey(filename.file), this);
+
+    //Listed children of a renamed folder move with it
+    QString dirPath = pathKey(filename.file) + "/";
+    for(quint16 childIndex = 0 ; childIndex < childCount() ; childIndex++) {
+        UiFileItem *item = (UiFileItem*)child(childIndex);
+        item->setFile(QFileInfo(dirPath + item->filename.file.fileName()));
+    }
+}
 
 
 void UiFileItem::syncWith(const QFileInfoList &files, QTreeWidget *treeWidget) {
     foreach(const QFileInfo &file, files) {
-        UiFileItem *existingItem = 0;
-        for(quint16 i = 0 ; i < treeWidget->topLevelItemCount() ; i++) {
-            UiFileItem *searchItem = ((UiFileItem*)treeWidget->topLevelItem(i))->find(file);
-            if(searchItem) {
-                existingItem = searchItem;
-                treeWidget->setCurrentItem(existingItem);
-                treeWidget->scrollToItem(existingItem);
-                break;
-            }
+        UiFileItem *existingItem = find(file, treeWidget);
+        if(existingItem) {
+            treeWidget->setCurrentItem(existingItem);
+            treeWidget->scrollToItem(existingItem);
         }
         if((!existingItem) && (file.exists())) {
             if(conformFile(file)) {
                 UiFileItem *baseItem = new UiFileItem(file, 0, 0);
                 treeWidget->addTopLevelItem(baseItem);
                 treeWidget->sortItems(0, Qt::AscendingOrder);
-                baseItem->syncWith(5);
+                connect(treeWidget, SIGNAL(itemExpanded(QTreeWidgetItem*)), baseItem, SLOT(itemExpanded(QTreeWidgetItem*)));
+                baseItem->syncWith(1);
                 baseItem->highlight();
                 treeWidget->clearSelection();
             }
@@ -251,8 +321,9 @@ QStringList UiFileItem::syncWith(const QDir &dir, qint16 depth) {
     if(currentDepth < 0)
         return directories;
 
-    //Listing
-    QFileInfoList files = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot, QDir::Name | QDir::IgnoreCase);
+    //Listing, shared with the project crawl
+    CrawlerListing entries = Crawler::listing(dir);
+    QString dirPath = QDir::cleanPath(dir.absolutePath()) + "/";
 
     //List all existing objects
     QHash<QString, UiFileItem*> pathChildren;
@@ -262,7 +333,8 @@ QStringList UiFileItem::syncWith(const QDir &dir, qint16 depth) {
     }
 
     //Parse files
-    foreach(const QFileInfo &file, files) {
+    foreach(const CrawlerEntry &entry, entries) {
+        QFileInfo file(dirPath + entry.name);
         QString fileAbsolutePath = file.absoluteFilePath();
         UiFileItem *item = 0;
         if(pathChildren.contains(fileAbsolutePath)) {
@@ -274,10 +346,12 @@ QStringList UiFileItem::syncWith(const QDir &dir, qint16 depth) {
                 item->fileWatcherDirChanged(QString());
         }
         else {
-            if(conformFile(file)) {
+            if(conformFile(entry.name, entry.isDir)) {
                 item = new UiFileItem(file, this, watcher);
-                if( file.isDir())                   directories.append(file.absoluteFilePath());
-                if((file.isDir()) && (depth > 0))   directories.append(item->syncWith(QDir(fileAbsolutePath + "/"), currentDepth-1));
+                if((entry.isDir) && (depth > 0)) {
+                    directories.append(file.absoluteFilePath());
+                    directories.append(item->syncWith(QDir(fileAbsolutePath + "/"), currentDepth-1));
+                }
             }
         }
     }
@@ -292,8 +366,30 @@ QStringList UiFileItem::syncWith(const QDir &dir, qint16 depth) {
 
     //Sorting
     sortChildren(0, Qt::AscendingOrder);
+    isPopulated = true;
+    setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicatorWhenChildless);
     return directories;
 }
+void UiFileItem::itemExpanded(QTreeWidgetItem *_item) {
+    //Only items of this root
+    UiFileItem *item = (UiFileItem*)_item;
+    if(item->getRoot() != this)
+        return;
+
+    if(!item->isPopulated)
+        item->syncWith(0);
+    item->prefetch();
+}
+void UiFileItem::prefetch() {
+    //One level ahead of what is displayed, listed by a worker thread
+    QStringList directories;
+    for(quint16 childIndex = 0 ; childIndex < childCount() ; childIndex++) {
+        UiFileItem *item = (UiFileItem*)child(childIndex);
+        if((!item->isFile) && (!item->isPopulated))
+            directories << item->filename.file.absoluteFilePath();
+    }
+    Crawler::prefetch(directories);
+}
 bool UiFileItem::highlight(UiSyncItem *item) {
     if(item) {
         treeWidget()->setCurrentItem(item);
@@ -327,6 +423,7 @@ void UiFileItem::fileWatcherDirChanged(QString dir) {
         qDebug("File(s) changed in directory %s", qPrintable(dir));
         if(filename.file.isDir()) {
             currentDepth = -1;
+            Crawler::invalidate(filename.file.absoluteFilePath());
             if(QDir(filename.file.absoluteFilePath()).exists())     syncWith(0);
             else                                                    askForDeletion(this);
         }
@@ -402,6 +499,14 @@ void UiFileItem::configure(UiTreeView *tree, bool _showDateTime) {
 }
 
 
+bool UiFileItem::conformFile(const QString &fileName, bool isDir) {
+    QFileInfo file(fileName);
+    if(isDir)
+        return !forbiddenDirs.contains(file.baseName());
+    else if(allowedExtensions.count())
+        return allowedExtensions.contains(file.suffix());
+    return true;
+}
 bool UiFileItem::conformFile(const QFileInfo &file) {
     if(file.isDir())
         return !forbiddenDirs.contains(file.baseName());
@@ -30,9 +30,11 @@
 #include <QMessageBox>
 #include <QFileSystemWatcher>
 #include <QTreeWidgetItem>
+#include <QSet>
 #include "uitreeview.h"
 #include "misc/options.h"
 #include "misc/global.h"
+#include "core/crawler.h"
 
 class UiFileItem : public QObject, public UiSyncItem {
     Q_OBJECT
@@ -40,6 +42,7 @@ class UiFileItem : public QObject, public UiSyncItem {
 private:
     UiBool       openInFinder, openInOs;
     qint16       currentDepth;
+    bool         isPopulated;
 public:
     UiFile filename;
     bool isFile;
@@ -49,6 +52,7 @@ public:
 
 public:
     explicit UiFileItem(const QFileInfo &file, UiFileItem *_parent, WatcherBase *_watcher);
+    ~UiFileItem();
     QVariant data(int column, int role) const;
     void setData(int column, int role, const QVariant &value);
 public:
@@ -69,6 +73,12 @@ public:
     static void configure(UiTreeView *, bool _showDateTime = true);
     UiFileItem* find(const QFileInfo &search);
     static UiFileItem* find(const QFileInfo &search, QTreeWidget *tree);
+    static UiFileItem* ensure(const QFileInfo &search, QTreeWidget *tree);
+private:
+    QHash<QString, UiFileItem*> itemsByPath;     //Filled on root items only
+    UiFileItem* getRoot();
+    static const QString pathKey(const QFileInfo &file);
+    void setFile(const QFileInfo &file);
 protected:
     void syncWith(qint16 depth);
     WatcherBase *watcher;
@@ -80,6 +90,9 @@ protected:
     static bool fileCopy  (const QFileInfo &source, const QFileInfo &dest);
     static bool fileRename(const QFileInfo &source, const QString &newNameWithoutSuffix, UiFileItem *item = 0);
     static bool fileRename(const QFileInfo &source, const QFileInfo &destination, UiFileItem *item = 0);
+protected slots:
+    void itemExpanded(QTreeWidgetItem *item);
+    void prefetch();
 public slots:
     void fileShowInFinder();
     void fileShowInOS();
@@ -95,7 +108,8 @@ protected slots:
 
 public:
     static bool conformFile(const QFileInfo &file);
-    static QStringList forbiddenDirs, allowedExtensions;
+    static bool conformFile(const QString &fileName, bool isDir);
+    static QSet<QString> forbiddenDirs, allowedExtensions;
 };
 
 #endif // UIFILEITEM_H
@@ -106,6 +106,8 @@ QColor       Global::colorAlternateStrong         = QColor(  0,   0,   0, 128);
 QColor       Global::colorTextBlack               = QColor( 45,  50,  53);      //QColor( 43,  46,  47)
 QColor       Global::colorTicks                   = QColor( 43,  46,  47);
 QColor       Global::colorBackground              = QColor( 71,  77,  79);
+QHash<QString, QPair<QString,QString> > Global::knownFileHashes;
+QMutex       Global::knownFileHashesMutex;
 QColor Global::getColorScale(qreal val) {
     QList<QColor> colors;
     if(val >= 100) {
@@ -238,6 +240,14 @@ QPair<QString, QPair<QString,QString> > Global::seperateMetadataAndGroup(const Q
 
 
 QString Global::getFileHash(const QFileInfo &file) {
+    //Hash already computed while the file was received (uploads)
+    QString fileStamp = QString("%1:%2").arg(file.size()).arg(file.lastModified().toMSecsSinceEpoch());
+    knownFileHashesMutex.lock();
+    QPair<QString,QString> knownHash = knownFileHashes.value(file.absoluteFilePath());
+    knownFileHashesMutex.unlock();
+    if((!knownHash.second.isEmpty()) && (knownHash.first == fileStamp))
+        return knownHash.second;
+
     QCryptographicHash fileHasher(QCryptographicHash::Sha1);
     QFile fileToHash(file.absoluteFilePath());
     fileToHash.open(QFile::ReadOnly);
@@ -245,6 +255,67 @@ QString Global::getFileHash(const QFileInfo &file) {
         fileHasher.addData(fileToHash.read(8192));
     return QString(fileHasher.result().toHex()).toUpper();
 }
+void Global::setFileHash(const QFileInfo &file, const QString &hash) {
+    QFileInfo fileStamped(file.absoluteFilePath());
+    QMutexLocker locker(&knownFileHashesMutex);
+    knownFileHashes.insert(fileStamped.absoluteFilePath(), qMakePair(QString("%1:%2").arg(fileStamped.size()).arg(fileStamped.lastModified().toMSecsSinceEpoch()), hash.toUpper()));
+}
+
+
+ObjectPool::ObjectPool(size_t _objectSize, quint16 _objectsPerBlock) {
+    objectSize        = _objectSize;
+    objectSizeAligned = ((qMax(objectSize, sizeof(void*)) + 15) / 16) * 16;
+    objectsPerBlock   = _objectsPerBlock;
+    freeList          = 0;
+    allocations = releases = liveObjects = 0;
+}
+void* ObjectPool::allocate(size_t size) {
+    if(size != objectSize)
+        return ::operator new(size);
+
+    QMutexLocker locker(&mutex);
+    if(!freeList) {
+        //A whole block is carved at once, free slots are chained through their first bytes
+        char *block = (char*)::operator new(objectSizeAligned * objectsPerBlock);
+        blocks.append(block);
+        for(quint16 i = 0 ; i < objectsPerBlock ; i++) {
+            void **slot = (void**)(block + i * objectSizeAligned);
+            *slot    = freeList;
+            freeList = slot;
+        }
+    }
+    void *object = freeList;
+    freeList = *(void**)object;
+    allocations++;
+    liveObjects++;
+    return object;
+}
+void ObjectPool::release(void *object, size_t size) {
+    if(!object)
+        return;
+    if(size != objectSize) {
+        ::operator delete(object);
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+    *(void**)object = freeList;
+    freeList = object;
+    releases++;
+    liveObjects--;
+}
+void ObjectPool::trim() {
+    QMutexLocker locker(&mutex);
+    if(liveObjects)
+        return;
+    foreach(char *block, blocks)
+        ::operator delete(block);
+    blocks.clear();
+    freeList = 0;
+}
+const QString ObjectPool::report(const QString &name) const {
+    return QString("[POOL] %1 : %2 allocations, %3 releases, %4 alive in %5 blocks of %6 x %7 bytes").arg(name).arg(allocations).arg(releases).arg(liveObjects).arg(blocks.count()).arg(objectsPerBlock).arg(objectSizeAligned);
+}
 
 
 FeedItemBase::FeedItemBase(FeedItemBaseType _action, const QString &_author, const QString &_object, const QDateTime &_date) {
@@ -40,6 +40,7 @@
 #include <QFileSystemWatcher>
 #include <QStyledItemDelegate>
 #include <QApplication>
+#include <QMutex>
 #include "core/sorting.h"
 #include "core/phases.h"
 #include "misc/options.h"
@@ -175,12 +176,14 @@ typedef QList<GlRect> Thumbnails;
 
 
 class WatcherBase : public QObject {
-public:
-    QFileSystemWatcher *watcher;
+    Q_OBJECT
 public:
     explicit WatcherBase(QObject *parent = 0) : QObject(parent) {}
     virtual void sync  (const QString &file, bool inTracker = false) = 0;
     virtual void unsync(const QString &file, bool inTracker = false) = 0;
+signals:
+    void directoryChanged(QString);
+    void fileChanged(QString);
 public slots:
     virtual void fileWatcherDirChanged (QString) = 0;
     virtual void fileWatcherFileChanged(QString) = 0;
@@ -188,6 +191,25 @@ public slots:
     virtual void takeTemporarySnapshot() = 0;
 };
 
+class ObjectPool {
+public:
+    explicit ObjectPool(size_t _objectSize, quint16 _objectsPerBlock = 512);
+
+private:
+    size_t       objectSize, objectSizeAligned;
+    quint16      objectsPerBlock;
+    QList<char*> blocks;
+    void        *freeList;
+    QMutex       mutex;
+public:
+    quint32      allocations, releases, liveObjects;
+public:
+    void* allocate(size_t size);
+    void  release(void *object, size_t size);
+    void  trim();
+    const QString report(const QString &name) const;
+};
+
 enum TaskProcessType { TaskProcessTypeProcess, TaskProcessTypeMetadata };
 class Metadata;
 class ProjectBase : public QObject, public GlDrawable {
@@ -198,8 +220,11 @@ public:
         noteId = 0;
     }
 public:
-    virtual void addDocument(void *document) = 0;
-    virtual void addPerson  (void* person) = 0;
+    virtual void addDocument   (void *document) = 0;
+    virtual void indexDocument (void *document) = 0;
+    virtual void removeDocument(void *document) = 0;
+    virtual void linkChutierItem(const QString &path, void *item, bool linked = true) = 0;
+    virtual void addPerson     (void* person) = 0;
 };
 class TaskListBase {
 public:
@@ -303,6 +328,8 @@ public:
     static RekallBase* mainWindow;
     static TaskListBase *taskList;
     static FeedListBase *feedList;
+    static QHash<QString, QPair<QString,QString> > knownFileHashes;
+    static QMutex knownFileHashesMutex;
 
 public:
     static const QString dateToString(const QDateTime &date, bool addExactTime = true);
@@ -320,6 +347,7 @@ public:
     static QPair<QString, QPair<QString,QString> > seperateMetadataAndGroup(const QString &metaline, const QString &separator = QString(":"));
     static QColor getColorScale(qreal val);
     static QString getFileHash(const QFileInfo &file);
+    static void    setFileHash(const QFileInfo &file, const QString &hash);
     static inline void inert(qreal *val, qreal valDest, qreal intertieFactor = 1) {
         if(qAbs(*val - valDest) < 0.01)
             *val = valDest;
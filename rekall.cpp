@@ -55,10 +55,14 @@ Rekall::Rekall(QWidget *parent) :
     Global::udp = new Udp(0, 5678);
     settings = new QSettings(Global::pathApplication.absoluteFilePath() + "/Rekall.ini", QSettings::IniFormat, this);
     if(true) {
-        httpUpload = new FileUploadController();
+        settings->beginGroup("media");
+        httpMedia = new StaticFileController(settings, this);
+        httpMedia->setDocroot(QString());
+        settings->endGroup();
         settings->beginGroup("listener");
-        http = new HttpListener(settings, httpUpload, this);
-        connect(httpUpload, SIGNAL(fileUploaded(QString,QString,QString)), SLOT(fileUploaded(QString,QString,QString)));
+        httpUpload = new FileUploadController(settings);
+        http = new HttpListener(settings, new RequestMapper(httpUpload, httpMedia, this), this);
+        connect(httpUpload, SIGNAL(fileUploaded(QString,QString,QString,QString)), SLOT(fileUploaded(QString,QString,QString,QString)));
     }
 
     Global::font.setFamily("Calibri");
@@ -215,9 +219,11 @@ Rekall::~Rekall() {
     delete ui;
 }
 
-void Rekall::fileUploaded(const QString &gpsCoord, const QString &filename, const QString &file) {
+void Rekall::fileUploaded(const QString &gpsCoord, const QString &filename, const QString &file, const QString &hash) {
     QFileInfo fileInfo(file);
     qDebug("Upload %s @ %s = %s (%d)", qPrintable(gpsCoord), qPrintable(filename), qPrintable(fileInfo.absoluteFilePath()), fileInfo.exists());
+    if(!hash.isEmpty())
+        Global::setFileHash(fileInfo, hash);
     Document *document = new Document(Global::currentProject);
     document->updateFile(fileInfo);
 
@@ -326,8 +332,8 @@ bool Rekall::parseMimeData(const QMimeData *mime, const QString &source, bool te
             }
             foreach(Document *droppedDocument, droppedDocuments) {
                 droppedDocument->createTag(TagTypeContextualTime, currentProject->getTimelineCursorTime(Global::timelineGL->mapFromGlobal(QCursor::pos()) + Global::timelineGL->scroll), 5);
-                if(droppedDocument->chutierItem)
-                    Global::chutier->setCurrentItem(droppedDocument->chutierItem);
+                if(droppedDocument->getChutierItem())
+                    Global::chutier->setCurrentItem(droppedDocument->getChutierItem());
                 retour = true;
             }
             Global::timelineSortChanged = Global::viewerSortChanged = Global::eventsSortChanged = true;
@@ -362,17 +368,22 @@ void Rekall::action() {
 
         if(shouldClose) {
             currentMetadatas.clear();
+            ui->player->unload();
+            changeAnnotation(0);
             currentProject->close();
             ui->chutier->getTree()->clear();
             Global::pathCurrent = QFileInfo();
+            HttpRequest::setUploadDirectory(QString());
+            httpMedia->setDocroot(QString());
             displayMetadata();
-            ui->player->unload();
             ui->centralwidgetStack->setCurrentIndex(1);
         }
 
         if((!dirToOpen.isEmpty()) && (QFileInfo(dirToOpen).exists())) {
             chutierIsUpdating = metadataIsUpdating = true;
             Global::pathCurrent = QFileInfo(dirToOpen);
+            HttpRequest::setUploadDirectory(Global::pathCurrent.absoluteFilePath() + "/Upload/");
+            httpMedia->setDocroot(Global::pathCurrent.absoluteFilePath());
             refreshMenus(Global::pathCurrent);
             if(!currentProject->open(QFileInfoList() << Global::pathCurrent, ui->chutier))
                 ui->timeline->setWorkspace(3);
@@ -392,16 +403,16 @@ void Rekall::action() {
         gps->show();
     else if((sender() == ui->metadataOpen) && (currentMetadatas.count())) {
         foreach(Metadata *currentMetadata, currentMetadatas) {
-            if(currentMetadata->chutierItem)
-                currentMetadata->chutierItem->fileShowInOS();
+            if(currentMetadata->getChutierItem())
+                currentMetadata->getChutierItem()->fileShowInOS();
             else
                 UiFileItem::fileShowInOS(currentMetadata->getMetadata("Rekall", "URL").toString());
         }
     }
     else if((sender() == ui->metadataOpenFinder) && (currentMetadatas.count())) {
         foreach(Metadata *currentMetadata, currentMetadatas) {
-            if(currentMetadata->chutierItem)
-                currentMetadata->chutierItem->fileShowInFinder();
+            if(currentMetadata->getChutierItem())
+                currentMetadata->getChutierItem()->fileShowInFinder();
             else if(currentMetadata->thumbnails.count())
                 UiFileItem::fileShowInFinder(currentMetadata->thumbnails.first().currentFilename);
         }
@@ -578,7 +589,7 @@ void Rekall::displayMetadataAndSelect(void *tag) {
     if(tag) {
         DocumentBase *metadata = ((Tag*)tag)->getDocument();
         if(metadata) {
-            UiFileItem *chutierItem = metadata->chutierItem;
+            UiFileItem *chutierItem = metadata->getChutierItem();
             if(chutierItem)
                 ui->chutier->getTree()->setCurrentItem(chutierItem);
         }
@@ -595,10 +606,10 @@ void Rekall::displayMetadata(QTreeWidgetItem *, QTreeWidgetItem *) {
     foreach(void *tag, Global::selectedTags) {
         Metadata *metadata = ((Tag*)tag)->getDocument();
         if((metadata) && (!currentMetadatas.contains(metadata))) {
-            UiFileItem *chutierItem = ((Document*)metadata)->chutierItem;
+            UiFileItem *chutierItem = ((Document*)metadata)->getChutierItem();
             if(chutierItem) {
                 //ui->chutier->getTree()->setCurrentItem(chutierItem);
-                ((Document*)metadata)->chutierItem->setSelected(true);
+                chutierItem->setSelected(true);
             }
 
             metadata->tempStorage = tag;
@@ -769,7 +780,7 @@ void Rekall::displayMetadata(QTreeWidgetItem *, QTreeWidgetItem *) {
                     else                                         ui->metadata->collapseItem(rootItem);
                 }
 
-                if((currentMetadata->chutierItem) || (currentMetadata->getType() == DocumentTypeWeb)) {
+                if((currentMetadata->getChutierItem()) || (currentMetadata->getType() == DocumentTypeWeb)) {
                     ui->metadataOpenFinder->setVisible(true);
                     ui->metadataOpen      ->setVisible(true);
                 }
@@ -38,6 +38,7 @@
 #include "interfaces/userinfos.h"
 #include "interfaces/http/httplistener.h"
 #include "interfaces/fileuploadcontroller.h"
+#include "interfaces/requestmapper.h"
 #include "items/uifileitem.h"
 #include "gui/splash.h"
 #include "gui/timeline.h"
@@ -68,6 +69,7 @@ private:
 private:
     HttpListener         *http;
     FileUploadController *httpUpload;
+    StaticFileController *httpMedia;
 private:
     bool annotationStateBeforeFocus, annotationIsUpdating;
     Tag *annotationTag;
@@ -88,7 +90,7 @@ protected:
 
 private slots:
     void refreshMenus(const QFileInfo &path = QFileInfo(), bool clear = false);
-    void fileUploaded(const QString &, const QString &, const QString &);
+    void fileUploaded(const QString &, const QString &, const QString &, const QString &);
     void action();
     void annotationFocusChanged(bool);
     void annotationFinished();
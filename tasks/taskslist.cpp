@@ -23,6 +23,7 @@
 
 #include "taskslist.h"
 #include "ui_taskslist.h"
+#include "core/tag.h"
 
 qint16 TasksList::runningTasks = 0;
 qint16 TasksList::runningWebTasks = 0;
@@ -53,6 +54,10 @@ void TasksList::setToolbox(QToolBox *_toolbox) {
 }
 
 void TasksList::clearTasks() {
+    //Running tasks still write into their documents, which are about to be deleted
+    foreach(TaskProcess *task, tasks)
+        if(task->started)
+            task->wait();
     tasks.clear();
 }
 
@@ -97,6 +102,11 @@ void TasksList::nextTask() {
         }
         else {
             hide();
+            if(Global::falseProject) {
+                Metadata::index.benchmark();
+                Metadata::benchmarkSuffixes();
+                TagRender::report(Tag::instances);
+            }
             Global::falseProject = false;
             if(toolbox->currentIndex() == 2)
                 toolbox->setCurrentIndex(oldToolboxIndex);
@@ -115,6 +125,9 @@ void TasksList::updateList(TaskProcess *task, const QString &message) {
 }
 
 void TasksList::finished(TaskProcess *task) {
+    //The content hash is only known once the task has run
+    if((Global::currentProject) && (task->document.metadata))
+        Global::currentProject->indexDocument(task->document.metadata);
     tasks.removeOne(task);
     ui->tasks->invisibleRootItem()->removeChild(task);
     runningTasks--;